@@ -57,6 +57,9 @@ void Error_Handler(void);
 /* USER CODE END EFP */
 
 /* Private defines -----------------------------------------------------------*/
+#define PCAL_INT_Pin GPIO_PIN_5
+#define PCAL_INT_GPIO_Port GPIOB
+#define PCAL_INT_EXTI_IRQn EXTI9_5_IRQn
 
 /* USER CODE BEGIN Private defines */
 
@@ -18,1147 +18,2801 @@
 
 #include "PCAL6524.h"
 
-uint8_t PCAL6524_ReadI2C(pcal6524_Device_t *device, uint8_t regAdress, uint8_t *data)
+#include <string.h> // For clearing and copying the shadow image.
+
+#if defined(STM32F1)
+#include "stm32f1xx_ll_i2c.h" // For the register-level transport.
+#endif
+
+/**
+ * @brief Longest register range updated from the shadow image in one call.
+ */
+#define PCAL6524_MAX_RANGE (8)
+
+/**
+ * @brief Marker of a retained shadow image that is kept in line with the chip.
+ */
+#define PCAL6524_RETAINED_MAGIC (0x50434137)
+
+/**
+ * @brief First and last register compared with the retained image on a warm restart (OUT, POL and CONF).
+ */
+#define PCAL6524_RETAINED_CHECK_FIRST (PCAL6524_REG_OUT_PORT_0)
+#define PCAL6524_RETAINED_CHECK_LAST (PCAL6524_REG_CONF_PORT_2)
+
+#if defined(SRAM_BB_BASE)
+/**
+ * @brief Size of the SRAM region reachable through bit-band aliases.
+ */
+#define PCAL6524_BITBAND_SIZE (0x100000UL)
+#endif
+
+/**
+ * @brief One bit per register that holds written configuration (0x04-0x0E, 0x40-0x5C, 0x60-0x65, 0x70-0x76).
+ * INT_CLEAR (0x68-0x6A) is write-only and acts on every write, so it is neither mirrored nor retained.
+ */
+static const uint32_t PCAL6524_WritableMap[(PCAL6524_REG_MAP_SIZE + 31) / 32] = {
+    0x00007770, 0x00000000, 0x1077773F, 0x0077003F};
+
+/**
+ * @brief Blocks of writable registers mirrored in the shadow image (first register, length, power-on value).
+ */
+static const uint8_t PCAL6524_ShadowBlocks[][3] = {
+    {PCAL6524_REG_OUT_PORT_0, 3, 0xFF},
+    {PCAL6524_REG_POL_PORT_0, 3, 0x00},
+    {PCAL6524_REG_CONF_PORT_0, 3, 0xFF},
+    {PCAL6524_REG_IN_LATCH_PORT_0, 3, 0x00},
+    {PCAL6524_REG_PULL_EN_PORT_0, 3, 0x00},
+    {PCAL6524_REG_PULL_SEL_PORT_0, 3, 0xFF},
+    {PCAL6524_REG_INT_MASK_PORT_0, 3, 0xFF},
+    {PCAL6524_REG_INT_EGDE_PORT_0A, 6, 0x00},
+    {PCAL6524_REG_DEBOUNCE_EN_PORT_0, 3, 0x00},
+};
+
+/**
+ * @brief Shadow images in RAM that the startup code leaves untouched, so they survive watchdog and software resets.
+ */
+static struct
 {
-    return HAL_I2C_Mem_Read(device->hi2c, (PCAL6524_ADDRESS + device->a0) << 1, regAdress, I2C_MEMADD_SIZE_8BIT, data, 1, PCAL6524_I2C_TIMEOUT);
-}
+    uint32_t magic;                        // PCAL6524_RETAINED_MAGIC while the image is kept in line.
+    uint32_t instance;                     // I2C peripheral of the device.
+    uint32_t a0;                           // Address pins of the device.
+    uint8_t shadow[PCAL6524_REG_MAP_SIZE]; // Register values that reached the chip.
+    uint32_t valid[(PCAL6524_REG_MAP_SIZE + 31) / 32]; // One bit per register, set if its value is known to be on the chip.
+    uint32_t checksum;                     // Inverted position-weighted sum over the fields above.
+} PCAL6524_Retained[PCAL6524_RETAINED_DEVICES] __attribute__((section(".noinit")));
 
-uint8_t PCAL6524_WriteI2C(pcal6524_Device_t *device, uint8_t regAdress, uint8_t *data)
+/**
+ * @brief Sets or clears one bit of a byte. In SRAM this is a single store to the bit-band alias (Cortex-M3),
+ * so interrupt and main-loop code can change bits of the same byte without a critical section.
+ */
+static inline void PCAL6524_WriteBit(uint8_t *byte, uint8_t bit, uint8_t value)
 {
-    return HAL_I2C_Mem_Write(device->hi2c, (PCAL6524_ADDRESS + device->a0) << 1, regAdress, I2C_MEMADD_SIZE_8BIT, data, 1, PCAL6524_I2C_TIMEOUT);
+    uint32_t primask = 0;
+#if defined(SRAM_BB_BASE)
+    uint32_t offset = (uint32_t)byte - SRAM_BASE;
+    if (offset < PCAL6524_BITBAND_SIZE)
+    {
+        *(volatile uint32_t *)(SRAM_BB_BASE + offset * 32U + bit * 4U) = value ? 1U : 0U;
+        return;
+    }
+#endif
+    primask = __get_PRIMASK();
+    __disable_irq();
+    *byte = value ? (*byte | (1 << bit)) : (*byte & ~(1 << bit));
+    __set_PRIMASK(primask);
 }
 
-uint8_t PCAL6524_SetInOut(pcal6524_Device_t *device, pcal6524_Port_t port, pcal6524_Pin_t pin, pcal6524_InOut_t io)
+static inline uint8_t PCAL6524_RegBit(const uint32_t *map, uint8_t reg)
 {
-    uint8_t data = 0;   // Holds data for i2c communication.
-    uint8_t status = 0; // Holds i2c status for error catching.
-    if (port > 2 || pin > 7 || io > 1)
-    { // Checks for input errors.
-        return PCAL6524_INPUTOUTOFRANGE;
+    return (map[reg >> 5] >> (reg & 31)) & 1;
+}
+
+static inline void PCAL6524_SetRegBit(uint32_t *map, uint8_t reg, uint8_t value)
+{ // Byte reg / 8 of the little-endian map holds the bit.
+    PCAL6524_WriteBit((uint8_t *)map + (reg >> 3), reg & 7, value);
+}
+
+static inline uint8_t PCAL6524_IsBridgeable(pcal6524_Device_t *device, uint8_t reg)
+{ // Gap bytes of a burst must not change the chip: cached or non-writable registers only, never INT_CLEAR.
+    if (reg >= PCAL6524_REG_INT_CLEAR_PORT_0 && reg <= PCAL6524_REG_INT_CLEAR_PORT_2)
+    {
+        return 0;
     }
-    /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
+    return PCAL6524_RegBit(device->shadowValid, reg) || !PCAL6524_RegBit(PCAL6524_WritableMap, reg);
+}
+
+static inline void PCAL6524_MergeShadow(pcal6524_Device_t *device, uint8_t reg, uint8_t mask, uint8_t bits)
+{ // Changes only the bits in mask, so pins marked meanwhile keep their value.
+    for (uint8_t bit = 0; bit < 8; bit++)
     {
-        switch (port)
-        { // Reads current setting of register.
-        case 0:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_CONF_PORT_0, &data);
-            break;
-        case 1:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_CONF_PORT_1, &data);
-            break;
-        case 2:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_CONF_PORT_2, &data);
-            break;
-        }
-        if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
-        }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
-            return HAL_ERROR;
-        }
-        else
+        if (mask & (1 << bit))
         {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
+            PCAL6524_WriteBit(&device->shadow[reg], bit, (bits >> bit) & 1);
         }
     }
-    /* Catches case when all attempts failed and returns last error code. */
-    if (status > HAL_OK)
+}
+
+static inline void PCAL6524_StoreShadow(pcal6524_Device_t *device, uint8_t reg, uint8_t value)
+{ // Takes a value that reached the chip unless marks or a batch still hold a newer one for the register.
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (!PCAL6524_RegBit(device->shadowDirty, reg))
     {
-        return status;
+        device->shadow[reg] = value;
     }
-    /* Combines current value of register with value that has to be changed. */
-    data = (data & (~(1 << pin))) | (io << pin);
-    /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
+    __set_PRIMASK(primask);
+}
+
+static uint32_t PCAL6524_RetainedSum(uint8_t slot)
+{ // Every term is weighted by its position, so a single changed byte adjusts the checksum without a full pass.
+    uint32_t sum = PCAL6524_Retained[slot].magic + PCAL6524_Retained[slot].instance + PCAL6524_Retained[slot].a0;
+    for (uint8_t reg = 0; reg < PCAL6524_REG_MAP_SIZE; reg++)
     {
-        switch (port)
-        { // Sends changed register settings to chip.
-        case 0:
-            status = PCAL6524_WriteI2C(device, PCAL6524_REG_CONF_PORT_0, &data);
-            break;
-        case 1:
-            status = PCAL6524_WriteI2C(device, PCAL6524_REG_CONF_PORT_1, &data);
-            break;
-        case 2:
-            status = PCAL6524_WriteI2C(device, PCAL6524_REG_CONF_PORT_2, &data);
-            break;
-        }
-        if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
+        sum += PCAL6524_Retained[slot].shadow[reg] * (reg + 1U);
+    }
+    for (uint8_t i = 0; i < sizeof(PCAL6524_Retained[slot].valid) / sizeof(uint32_t); i++)
+    {
+        sum += PCAL6524_Retained[slot].valid[i] * (PCAL6524_REG_MAP_SIZE + i + 1U);
+    }
+    return ~sum;
+}
+
+static void PCAL6524_RetainRegister(uint8_t slot, uint8_t reg, uint8_t value, uint8_t valid)
+{ // Caller holds interrupts off. ~(s + d) == ~s - d, so the stored inverted sum takes the difference directly.
+    uint32_t *word = &PCAL6524_Retained[slot].valid[reg >> 5];
+    uint32_t bits = valid ? (*word | (1UL << (reg & 31))) : (*word & ~(1UL << (reg & 31)));
+    PCAL6524_Retained[slot].checksum -= (bits - *word) * (PCAL6524_REG_MAP_SIZE + (reg >> 5) + 1U);
+    *word = bits;
+    if (valid)
+    {
+        PCAL6524_Retained[slot].checksum -= ((uint32_t)value - PCAL6524_Retained[slot].shadow[reg]) * (reg + 1U);
+        PCAL6524_Retained[slot].shadow[reg] = value;
+    }
+}
+
+static uint8_t PCAL6524_FindRetained(pcal6524_Device_t *device, uint8_t claim)
+{
+    uint8_t unused = PCAL6524_RETAINED_DEVICES; // First slot without a kept image.
+    for (uint8_t slot = 0; slot < PCAL6524_RETAINED_DEVICES; slot++)
+    {
+        if (PCAL6524_Retained[slot].magic != PCAL6524_RETAINED_MAGIC)
+        {
+            unused = (unused == PCAL6524_RETAINED_DEVICES) ? slot : unused;
         }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
-            return HAL_ERROR;
+        else if (PCAL6524_Retained[slot].instance == (uint32_t)device->hi2c->Instance && PCAL6524_Retained[slot].a0 == device->a0)
+        {
+            return slot;
         }
-        else
+    }
+    return claim ? unused : PCAL6524_RETAINED_DEVICES;
+}
+
+static void PCAL6524_Retain(pcal6524_Device_t *device)
+{
+    uint8_t slot = PCAL6524_FindRetained(device, 1);
+    uint32_t primask = 0;
+    if (slot == PCAL6524_RETAINED_DEVICES)
+    { // All slots are taken by other devices.
+        return;
+    }
+    primask = __get_PRIMASK();
+    __disable_irq(); // Completing writes update the checksum from interrupt context.
+    PCAL6524_Retained[slot].magic = PCAL6524_RETAINED_MAGIC;
+    PCAL6524_Retained[slot].instance = (uint32_t)device->hi2c->Instance;
+    PCAL6524_Retained[slot].a0 = device->a0;
+    memset(PCAL6524_Retained[slot].valid, 0, sizeof(PCAL6524_Retained[slot].valid));
+    for (uint8_t reg = 0; reg < PCAL6524_REG_MAP_SIZE; reg++)
+    { // Values still waiting in a batch have not reached the chip yet.
+        if (PCAL6524_RegBit(device->shadowValid, reg) && !PCAL6524_RegBit(device->shadowDirty, reg))
         {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
+            PCAL6524_Retained[slot].shadow[reg] = device->shadow[reg];
+            PCAL6524_Retained[slot].valid[reg >> 5] |= 1UL << (reg & 31);
         }
     }
-    /* Catches case when all attempts failed and returns last error code. */
-    if (status > HAL_OK)
+    PCAL6524_Retained[slot].checksum = PCAL6524_RetainedSum(slot);
+    __set_PRIMASK(primask);
+}
+
+static void PCAL6524_RetainWrite(const pcal6524_Request_t *request, uint8_t status)
+{
+    uint8_t slot = PCAL6524_FindRetained(request->device, 0);
+    uint8_t reg = request->command & ~PCAL6524_AUTO_INCREMENT;
+    uint16_t i = 0;
+    uint32_t primask = 0;
+    if (slot == PCAL6524_RETAINED_DEVICES || request->read)
     {
-        return status;
+        return;
     }
-    return PCAL6524_SUCCESS; // Returns success code when transmission successful.
+    if (!(request->command & PCAL6524_AUTO_INCREMENT))
+    { // Every data byte went to the same register, only the last one stays.
+        i = request->len - 1;
+    }
+    primask = __get_PRIMASK();
+    __disable_irq();
+    for (uint8_t r = reg; i < request->len && r < PCAL6524_REG_MAP_SIZE; i++, r++)
+    {
+        if (PCAL6524_RegBit(PCAL6524_WritableMap, r))
+        { // A failed write leaves these registers unknown until the next PCAL6524_RefreshShadow.
+            PCAL6524_RetainRegister(slot, r, request->data[i], status == HAL_OK);
+        }
+    }
+    __set_PRIMASK(primask);
 }
-uint8_t PCAL6524_GetInOutConfig(pcal6524_Device_t *device, pcal6524_Port_t port, uint8_t *ios)
+
+static void PCAL6524_StartCycleCounter(void)
 {
-    uint8_t status = 0; // Holds i2c status for error catching.
-    if (port > 2)
-    { // Checks for input errors.
-        return PCAL6524_INPUTOUTOFRANGE;
+#if defined(DWT)
+    if ((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) == 0)
+    {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
     }
-    /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
+#endif
+}
+
+static inline uint32_t PCAL6524_Cycles(void)
+{
+#if defined(DWT)
+    return DWT->CYCCNT;
+#else // Cortex-M0 without cycle counter, resolution of one tick.
+    return HAL_GetTick() * (SystemCoreClock / 1000U);
+#endif
+}
+
+static inline uint32_t PCAL6524_UsToCycles(uint32_t us)
+{
+    return us * (SystemCoreClock / 1000000U);
+}
+
+static void PCAL6524_DelayUs(uint32_t us)
+{
+    uint32_t start = 0;
+    uint32_t cycles = PCAL6524_UsToCycles(us);
+    PCAL6524_StartCycleCounter(); // The counter has to run before the start value means anything.
+    start = PCAL6524_Cycles();
+    while (PCAL6524_Cycles() - start < cycles)
     {
-        switch (port)
-        { // Reads current setting of register.
-        case 0:
+    }
+}
 
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_CONF_PORT_0, ios);
-            break;
-        case 1:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_CONF_PORT_1, ios);
-            break;
-        case 2:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_CONF_PORT_2, ios);
-            break;
-        }
-        if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
-        }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
-            return HAL_ERROR;
-        }
-        else
-        {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
-        }
+/**
+ * @brief  Decides whether a failed attempt is repeated.
+ * @param  attempts Attempts made so far.
+ * @param  start    Cycle count of the first attempt.
+ * @param  *delay   Output variable for the wait before the next attempt [us].
+ * @retval 1 to repeat, 0 to give up.
+ */
+static uint8_t PCAL6524_NextRetry(const pcal6524_Device_t *device, uint8_t status, uint8_t attempts, uint32_t start, uint32_t *delay)
+{
+    const pcal6524_RetryPolicy_t *policy = &device->retry;
+    if ((status != HAL_BUSY && status != HAL_TIMEOUT) || attempts >= policy->maxAttempts)
+    { // Only a busy or slow bus is worth another attempt.
+        return 0;
     }
-    /* Catches case when all attempts failed and returns last error code. */
-    if (status > HAL_OK)
+    *delay = policy->baseDelayUs;
+    switch (policy->backoff)
     {
-        return status;
+    case PCAL6524_BackoffLinear:
+        *delay *= attempts;
+        break;
+    case PCAL6524_BackoffExponential:
+        *delay <<= (attempts < 16) ? attempts - 1 : 15;
+        break;
+    default:
+        break;
+    }
+    if (*delay > policy->maxDelayUs)
+    {
+        *delay = policy->maxDelayUs;
     }
-    return PCAL6524_SUCCESS; // Returns success code when transmission successful.
+    if (policy->deadlineUs > 0 && PCAL6524_Cycles() - start + PCAL6524_UsToCycles(*delay) > PCAL6524_UsToCycles(policy->deadlineUs))
+    { // Next attempt would start after the deadline.
+        return 0;
+    }
+    return 1;
 }
-uint8_t PCAL6524_SetInterrupt(
-    pcal6524_Device_t *device, pcal6524_Port_t port,
-    pcal6524_Pin_t pin, pcal6524_InterruptEN_t intr)
+
+static void PCAL6524_CountRetryResult(pcal6524_Device_t *device, uint8_t status, uint8_t attempts)
 {
-    uint8_t data = 0;   // Holds data for i2c communication.
-    uint8_t status = 0; // Holds i2c status for error catching.
-    /* Checks for input errors. */
-    if (port > 2 || pin > 7 || intr > 1)
+    device->retryStats.transfers++;
+    if (status == HAL_OK && attempts > 1)
     {
-        return PCAL6524_INPUTOUTOFRANGE;
-    } /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
+        device->retryStats.recovered++;
+    }
+    else if (status == HAL_BUSY || status == HAL_TIMEOUT)
     {
-        switch (port)
-        { // Reads current setting of register.
-        case 0:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_INT_MASK_PORT_0, &data);
-            break;
-        case 1:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_INT_MASK_PORT_1, &data);
-            break;
-        case 2:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_INT_MASK_PORT_2, &data);
-            break;
-        }
-        if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
-        }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
-            return HAL_ERROR;
-        }
-        else
-        {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
-        }
+        device->retryStats.exhausted++;
     }
-    /* Catches case when all attempts failed and returns last error code. */
-    if (status > HAL_OK)
+}
+
+static void PCAL6524_RecordHealth(pcal6524_Device_t *device, uint8_t status)
+{
+    if (status == HAL_OK)
     {
-        return status;
+        device->health.failures = 0;
+        return;
     }
-    /* Combines current value of register with value that has to be changed. */
-    data = (data & (~(0b1 << pin))) | (~(intr) << pin);
-    /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
+    if (device->busSpeed.errors < UINT8_MAX)
     {
-        switch (port)
-        { // Sends changed register settings to chip.
-        case 0:
-            status = PCAL6524_WriteI2C(device, PCAL6524_REG_INT_MASK_PORT_0, &data);
-            break;
-        case 1:
-            status = PCAL6524_WriteI2C(device, PCAL6524_REG_INT_MASK_PORT_1, &data);
-            break;
-        case 2:
-            status = PCAL6524_WriteI2C(device, PCAL6524_REG_INT_MASK_PORT_2, &data);
-            break;
-        }
-        if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
-        }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
+        device->busSpeed.errors++;
+    }
+    if (device->health.failures < UINT8_MAX)
+    {
+        device->health.failures++;
+    }
+    if (device->health.state == PCAL6524_HealthOnline && device->health.failures >= PCAL6524_BREAKER_THRESHOLD)
+    { // Stops spending timeouts on a device that does not answer.
+        device->health.state = PCAL6524_HealthOffline;
+        device->health.since = HAL_GetTick();
+        device->health.trips++;
+    }
+}
+
+static pcal6524_Request_t PCAL6524_Active;                   // Transfer currently on the bus.
+static volatile uint8_t PCAL6524_ActiveBusy = 0;             // Set while PCAL6524_Active is in flight.
+static volatile uint8_t PCAL6524_ActiveParked = 0;           // Set while PCAL6524_Active waits for its repetition.
+static pcal6524_Request_t PCAL6524_Queue[PCAL6524_QUEUE_SIZE]; // Transfers waiting for the bus.
+static volatile uint8_t PCAL6524_QueueHead = 0;              // Next transfer to start.
+static volatile uint8_t PCAL6524_QueueCount = 0;             // Number of waiting transfers.
+
+/**
+ * @brief Completion state of a transfer that a blocking API call waits for.
+ */
+typedef struct
+{
+    volatile uint8_t done;
+    volatile uint8_t status;
+} pcal6524_Wait_t;
+
+static void PCAL6524_RecoverI2C(I2C_HandleTypeDef *hi2c)
+{ // Aborts DMA and re-initializes the peripheral; the software reset inside HAL_I2C_Init clears a stuck BUSY flag (STM32F1 errata).
+    if (hi2c->hdmarx != NULL)
+    {
+        HAL_DMA_Abort(hi2c->hdmarx);
+    }
+    if (hi2c->hdmatx != NULL)
+    {
+        HAL_DMA_Abort(hi2c->hdmatx);
+    }
+    HAL_I2C_Init(hi2c);
+}
+
+#if defined(STM32F1)
+/**
+ * @brief Polls of an I2C flag before an LL transfer gives up (about 1 ms at 72 MHz).
+ */
+#define PCAL6524_LL_SPIN_LIMIT (20000UL)
+
+static uint8_t PCAL6524_LL_WaitFlag(I2C_TypeDef *i2c, uint32_t flag)
+{
+    uint32_t spin = PCAL6524_LL_SPIN_LIMIT;
+    while (READ_BIT(i2c->SR1, flag) == 0)
+    {
+        if (LL_I2C_IsActiveFlag_AF(i2c))
+        { // Device did not acknowledge.
             return HAL_ERROR;
         }
-        else
+        if (--spin == 0)
         {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
+            return HAL_TIMEOUT;
         }
     }
-    /* Catches case when all attempts failed and returns last error code. */
+    return HAL_OK;
+}
+
+static uint8_t PCAL6524_LL_Address(I2C_TypeDef *i2c, uint8_t address)
+{ // Sends (repeated) START and the address byte, leaves ADDR set.
+    uint8_t status = 0; // Holds i2c status for error catching.
+    LL_I2C_GenerateStartCondition(i2c);
+    status = PCAL6524_LL_WaitFlag(i2c, I2C_SR1_SB);
     if (status > HAL_OK)
     {
         return status;
     }
-    return PCAL6524_SUCCESS; // Returns success code when transmission successful.
+    LL_I2C_TransmitData8(i2c, address);
+    return PCAL6524_LL_WaitFlag(i2c, I2C_SR1_ADDR);
 }
-uint8_t PCAL6524_GetInterruptConfig(
-    pcal6524_Device_t *device, pcal6524_Port_t port,
-    uint8_t *intr)
-{
+
+static uint8_t PCAL6524_LL_Receive(I2C_TypeDef *i2c, uint8_t *data, uint16_t len)
+{ // Reception sequences for 1, 2 and N bytes of RM0008, STOP/NACK must be set before the last byte is shifted in.
     uint8_t status = 0; // Holds i2c status for error catching.
-    if (port > 2)
-    { // Checks for input errors.
-        return PCAL6524_INPUTOUTOFRANGE;
-    }
-    /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
+    uint32_t primask = __get_PRIMASK();
+    if (len == 1)
     {
-        switch (port)
-        { // Reads current setting of register.
-        case 0:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_INT_MASK_PORT_0, intr);
-            break;
-        case 1:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_INT_MASK_PORT_1, intr);
-            break;
-        case 2:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_INT_MASK_PORT_2, intr);
-            break;
-        }
+        LL_I2C_AcknowledgeNextData(i2c, LL_I2C_NACK);
+        __disable_irq();
+        LL_I2C_ClearFlag_ADDR(i2c);
+        LL_I2C_GenerateStopCondition(i2c);
+        __set_PRIMASK(primask);
+        status = PCAL6524_LL_WaitFlag(i2c, I2C_SR1_RXNE);
         if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
+        {
+            data[0] = LL_I2C_ReceiveData8(i2c);
         }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
-            return HAL_ERROR;
+        return status;
+    }
+    if (len == 2)
+    {
+        LL_I2C_AcknowledgeNextData(i2c, LL_I2C_NACK);
+        LL_I2C_EnableBitPOS(i2c);
+        LL_I2C_ClearFlag_ADDR(i2c);
+        status = PCAL6524_LL_WaitFlag(i2c, I2C_SR1_BTF);
+        if (status == HAL_OK)
+        {
+            __disable_irq();
+            LL_I2C_GenerateStopCondition(i2c);
+            data[0] = LL_I2C_ReceiveData8(i2c);
+            __set_PRIMASK(primask);
+            data[1] = LL_I2C_ReceiveData8(i2c);
         }
-        else
+        return status;
+    }
+    LL_I2C_ClearFlag_ADDR(i2c);
+    for (; len > 3; len--)
+    {
+        status = PCAL6524_LL_WaitFlag(i2c, I2C_SR1_RXNE);
+        if (status > HAL_OK)
         {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
+            return status;
         }
+        *data++ = LL_I2C_ReceiveData8(i2c);
     }
-    /* Catches case when all attempts failed and returns last error code. */
+    status = PCAL6524_LL_WaitFlag(i2c, I2C_SR1_BTF); // Byte N-2 in DR, N-1 in shift register.
     if (status > HAL_OK)
     {
         return status;
     }
-    return PCAL6524_SUCCESS; // Returns success code when transmission successful.
+    LL_I2C_AcknowledgeNextData(i2c, LL_I2C_NACK);
+    __disable_irq();
+    data[0] = LL_I2C_ReceiveData8(i2c);
+    LL_I2C_GenerateStopCondition(i2c);
+    data[1] = LL_I2C_ReceiveData8(i2c);
+    __set_PRIMASK(primask);
+    status = PCAL6524_LL_WaitFlag(i2c, I2C_SR1_RXNE);
+    if (status == HAL_OK)
+    {
+        data[2] = LL_I2C_ReceiveData8(i2c);
+    }
+    return status;
 }
-uint8_t PCAL6524_SetPullupDown(
-    pcal6524_Device_t *device, pcal6524_Port_t port,
-    pcal6524_Pin_t pin, pcal6524_PullUpDown_t pull,
-    pcal6524_PullUpDownEN_t active)
+
+static uint8_t PCAL6524_LLTransfer(const pcal6524_Request_t *request)
 {
-    uint8_t data = 0;   // Holds data for i2c communication.
+    I2C_TypeDef *i2c = request->device->hi2c->Instance;
+    uint8_t address = (PCAL6524_ADDRESS + request->device->a0) << 1;
     uint8_t status = 0; // Holds i2c status for error catching.
-    /* Checks for input errors. */
-    if (port > 2 || pin > 7 || pull > 1 || active > 1)
+    uint32_t spin = PCAL6524_LL_SPIN_LIMIT;
+    while (LL_I2C_IsActiveFlag_BUSY(i2c))
     {
-        return PCAL6524_INPUTOUTOFRANGE;
+        if (--spin == 0)
+        { // BUSY flag locked (STM32F1 errata), resets the peripheral for the next attempt.
+            PCAL6524_RecoverI2C(request->device->hi2c);
+            return HAL_BUSY;
+        }
     }
-    /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
+    LL_I2C_DisableBitPOS(i2c);
+    LL_I2C_AcknowledgeNextData(i2c, LL_I2C_ACK);
+    status = PCAL6524_LL_Address(i2c, address);
+    if (status == HAL_OK)
     {
-        /* Reads current setting of pull-up/pull-down select register. */
-        switch (port)
+        LL_I2C_ClearFlag_ADDR(i2c);
+        LL_I2C_TransmitData8(i2c, request->command);
+        for (uint16_t i = 0; i < request->len && !request->read && status == HAL_OK; i++)
         {
-        case 0:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_PULL_SEL_PORT_0, &data);
-            break;
-        case 1:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_PULL_SEL_PORT_1, &data);
-            break;
-        case 2:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_PULL_SEL_PORT_2, &data);
-            break;
+            status = PCAL6524_LL_WaitFlag(i2c, I2C_SR1_TXE);
+            if (status == HAL_OK)
+            {
+                LL_I2C_TransmitData8(i2c, request->data[i]);
+            }
         }
+    }
+    if (status == HAL_OK)
+    {
+        status = PCAL6524_LL_WaitFlag(i2c, I2C_SR1_BTF);
+    }
+    if (status == HAL_OK && request->read)
+    {
+        status = PCAL6524_LL_Address(i2c, address | 1);
         if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
-        }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
-            return HAL_ERROR;
-        }
-        else
         {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
+            status = PCAL6524_LL_Receive(i2c, request->data, request->len);
         }
     }
-    /* Catches case when all attempts failed and returns last error code. */
+    else if (status == HAL_OK)
+    {
+        LL_I2C_GenerateStopCondition(i2c);
+    }
     if (status > HAL_OK)
+    { // Releases the bus after NACK or timeout.
+        LL_I2C_GenerateStopCondition(i2c);
+        LL_I2C_ClearFlag_AF(i2c);
+    }
+    LL_I2C_DisableBitPOS(i2c);
+    LL_I2C_AcknowledgeNextData(i2c, LL_I2C_ACK);
+    return status;
+}
+#endif
+
+static uint8_t PCAL6524_BlockingTransfer(const pcal6524_Request_t *request)
+{
+    uint16_t address = (PCAL6524_ADDRESS + request->device->a0) << 1;
+#if defined(STM32F1)
+    if (request->device->transport == PCAL6524_TransportLL)
     {
-        return status;
+        return PCAL6524_LLTransfer(request);
     }
-    /* Combines current value of register with value that has to be changed. */
-    data = (data & (~(0b1 << pin))) | (pull << pin);
-    /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
+#endif
+    if (request->read)
+    {
+        return HAL_I2C_Mem_Read(request->device->hi2c, address, request->command, I2C_MEMADD_SIZE_8BIT, request->data, request->len, PCAL6524_I2C_TIMEOUT);
+    }
+    return HAL_I2C_Mem_Write(request->device->hi2c, address, request->command, I2C_MEMADD_SIZE_8BIT, request->data, request->len, PCAL6524_I2C_TIMEOUT);
+}
+
+static uint8_t PCAL6524_InterruptTransfer(const pcal6524_Request_t *request)
+{
+    uint16_t address = (PCAL6524_ADDRESS + request->device->a0) << 1;
+    if (request->read)
+    {
+        return HAL_I2C_Mem_Read_IT(request->device->hi2c, address, request->command, I2C_MEMADD_SIZE_8BIT, request->data, request->len);
+    }
+    return HAL_I2C_Mem_Write_IT(request->device->hi2c, address, request->command, I2C_MEMADD_SIZE_8BIT, request->data, request->len);
+}
+
+static uint8_t PCAL6524_DMATransfer(const pcal6524_Request_t *request)
+{
+    uint16_t address = (PCAL6524_ADDRESS + request->device->a0) << 1;
+    if (request->read && request->len < 2)
+    { // DMA reception of a single byte misses the STOP timing on STM32F1 (errata), so it is done by interrupt.
+        return PCAL6524_InterruptTransfer(request);
+    }
+    if (request->read)
+    {
+        return HAL_I2C_Mem_Read_DMA(request->device->hi2c, address, request->command, I2C_MEMADD_SIZE_8BIT, request->data, request->len);
+    }
+    return HAL_I2C_Mem_Write_DMA(request->device->hi2c, address, request->command, I2C_MEMADD_SIZE_8BIT, request->data, request->len);
+}
+
+static void PCAL6524_Launch(void);
+
+static void PCAL6524_CompleteTransfer(uint8_t status)
+{
+    pcal6524_Request_t request = PCAL6524_Active; // Copy, so the next transfer can take its place.
+    uint8_t reg = request.command & ~PCAL6524_AUTO_INCREMENT;
+    uint8_t step = (request.command & PCAL6524_AUTO_INCREMENT) ? 1 : 0;
+    uint8_t next = 0; // Set if a queued transfer takes over the bus.
+    uint32_t primask = 0;
+    uint32_t delay = 0; // Wait before a repetition [us].
+    if (request.reschedule && status != HAL_OK && PCAL6524_NextRetry(request.device, status, request.attempts, request.start, &delay))
+    { // Keeps the bus reserved until the repetition is due, PCAL6524_ServiceRetries starts it.
+        PCAL6524_Active.due = PCAL6524_Cycles() + PCAL6524_UsToCycles(delay);
+        PCAL6524_ActiveParked = 1;
+        request.device->retryStats.retries++;
+        request.device->retryStats.rescheduled++;
+        return;
+    }
+    if (request.reschedule)
     {
-        /* Sends changed setting in pull-up/pull-down select register to chip. */
-        switch (port)
+        PCAL6524_CountRetryResult(request.device, status, request.attempts);
+        PCAL6524_RecordHealth(request.device, status);
+    }
+    PCAL6524_RetainWrite(&request, status);
+    if (!request.read)
+    { // Keeps the shadow image in line with what reached the chip.
+        for (uint16_t i = step ? 0 : request.len - 1; i < request.len && reg + i * step < PCAL6524_REG_MAP_SIZE; i++)
         {
-        case 0:
-            status = PCAL6524_WriteI2C(device, PCAL6524_REG_PULL_SEL_PORT_0, &data);
-            break;
-        case 1:
-            status = PCAL6524_WriteI2C(device, PCAL6524_REG_PULL_SEL_PORT_1, &data);
-            break;
-        case 2:
-            status = PCAL6524_WriteI2C(device, PCAL6524_REG_PULL_SEL_PORT_2, &data);
-            break;
+            if (PCAL6524_RegBit(PCAL6524_WritableMap, reg + i * step))
+            {
+                if (&request.data[i] != &request.device->shadow[reg + i * step])
+                { // Batch commits send straight from the image, a copy could undo a concurrent pin mark.
+                    PCAL6524_StoreShadow(request.device, reg + i * step, request.data[i]);
+                }
+                PCAL6524_SetRegBit(request.device->shadowValid, reg + i * step, status == HAL_OK);
+            }
         }
-        if (status == HAL_OK)
-        { // Breaks out of loop when successful.
+    }
+    /* Hands the bus to the next queued transfer. */
+    primask = __get_PRIMASK();
+    __disable_irq();
+    if (PCAL6524_QueueCount > 0)
+    {
+        PCAL6524_Active = PCAL6524_Queue[PCAL6524_QueueHead];
+        PCAL6524_QueueHead = (PCAL6524_QueueHead + 1) % PCAL6524_QUEUE_SIZE;
+        PCAL6524_QueueCount--;
+        next = 1;
+    }
+    else
+    {
+        PCAL6524_ActiveBusy = 0;
+    }
+    __set_PRIMASK(primask);
+    if (request.callback != NULL)
+    {
+        request.callback(request.device, status, request.context);
+    }
+    if (next)
+    {
+        PCAL6524_Launch();
+    }
+}
+
+static void PCAL6524_Launch(void)
+{
+    uint8_t status = 0; // Holds i2c status for error catching.
+    I2C_HandleTypeDef *hi2c = PCAL6524_Active.device->hi2c;
+    if (PCAL6524_Active.device->transport == PCAL6524_TransportDMA && !(PCAL6524_Active.read && PCAL6524_Active.len < 2) && __get_IPSR() != 0U)
+    { // HAL_I2C_Mem_*_DMA poll the address phase against HAL_GetTick, which stands still in interrupts; PCAL6524_ServiceRetries starts it.
+        PCAL6524_Active.due = PCAL6524_Cycles();
+        PCAL6524_ActiveParked = 1;
+        return;
+    }
+    if (PCAL6524_Active.attempts++ == 0)
+    {
+        PCAL6524_Active.start = PCAL6524_Cycles();
+    }
+    for (uint8_t attempt = 0; attempt < 2; attempt++)
+    {
+        switch (PCAL6524_Active.device->transport)
+        {
+        case PCAL6524_TransportDMA:
+            status = PCAL6524_DMATransfer(&PCAL6524_Active);
+            break;
+        case PCAL6524_TransportIT:
+            status = PCAL6524_InterruptTransfer(&PCAL6524_Active);
             break;
+        default: // Blocking and LL transport complete in place.
+            PCAL6524_CompleteTransfer(PCAL6524_BlockingTransfer(&PCAL6524_Active));
+            return;
         }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
-            return HAL_ERROR;
+        if (status == HAL_BUSY && hi2c->State == HAL_I2C_STATE_READY && __HAL_I2C_GET_FLAG(hi2c, I2C_FLAG_BUSY))
+        { // BUSY flag locked while the peripheral is idle (STM32F1 errata), resets it once.
+            PCAL6524_RecoverI2C(hi2c);
+            continue;
         }
-        else
+        break;
+    }
+    if (status != HAL_OK)
+    { // Reports the failed start like a failed transfer and moves on.
+        PCAL6524_CompleteTransfer(status);
+    }
+}
+
+static uint8_t PCAL6524_Submit(const pcal6524_Request_t *request)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (!PCAL6524_ActiveBusy)
+    {
+        PCAL6524_Active = *request;
+        PCAL6524_ActiveBusy = 1;
+        __set_PRIMASK(primask);
+        PCAL6524_Launch();
+        return HAL_OK;
+    }
+    if (PCAL6524_QueueCount >= PCAL6524_QUEUE_SIZE)
+    {
+        __set_PRIMASK(primask);
+        return HAL_BUSY;
+    }
+    PCAL6524_Queue[(PCAL6524_QueueHead + PCAL6524_QueueCount) % PCAL6524_QUEUE_SIZE] = *request;
+    PCAL6524_QueueCount++;
+    __set_PRIMASK(primask);
+    return HAL_OK;
+}
+
+static void PCAL6524_AbortActive(void)
+{ // Frees the bus when a completion interrupt never arrives.
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (PCAL6524_ActiveBusy && !PCAL6524_ActiveParked)
+    {
+        PCAL6524_RecoverI2C(PCAL6524_Active.device->hi2c);
+        __set_PRIMASK(primask);
+        PCAL6524_CompleteTransfer(HAL_TIMEOUT);
+        return;
+    }
+    __set_PRIMASK(primask);
+}
+
+void PCAL6524_ServiceRetries(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (PCAL6524_ActiveParked && (int32_t)(PCAL6524_Cycles() - PCAL6524_Active.due) >= 0)
+    {
+        PCAL6524_ActiveParked = 0;
+        __set_PRIMASK(primask);
+        PCAL6524_Launch();
+        return;
+    }
+    __set_PRIMASK(primask);
+}
+
+static void PCAL6524_WaitCallback(pcal6524_Device_t *device, uint8_t status, void *context)
+{
+    pcal6524_Wait_t *wait = (pcal6524_Wait_t *)context;
+    wait->status = status;
+    wait->done = 1;
+}
+
+static void PCAL6524_WaitBusIdle(void)
+{ // Lets queued asynchronous transfers finish before using the bus directly.
+    uint32_t tickstart = HAL_GetTick();
+    while (PCAL6524_ActiveBusy)
+    {
+        PCAL6524_ServiceRetries();
+        if ((HAL_GetTick() - tickstart) > PCAL6524_I2C_TIMEOUT)
         {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
+            PCAL6524_AbortActive();
+            tickstart = HAL_GetTick();
         }
     }
-    /* Catches case when all attempts failed and returns last error code. */
+}
+
+static uint8_t PCAL6524_Transfer(const pcal6524_Request_t *request)
+{
+    pcal6524_Wait_t wait = {0, 0};         // Completion state of this transfer.
+    pcal6524_Request_t queued = *request;  // Request with completion routed to wait.
+    uint32_t tickstart = HAL_GetTick();
+    uint8_t status = 0; // Holds i2c status for error catching.
+    if (request->device->transport == PCAL6524_TransportBlocking || request->device->transport == PCAL6524_TransportLL)
+    {
+        PCAL6524_WaitBusIdle();
+        status = PCAL6524_BlockingTransfer(request);
+        PCAL6524_RetainWrite(request, status);
+        return status;
+    }
+    queued.callback = PCAL6524_WaitCallback;
+    queued.context = &wait;
+    status = PCAL6524_Submit(&queued);
     if (status > HAL_OK)
     {
         return status;
     }
-    /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
+    while (!wait.done)
     {
-        /* Reads current setting of pull-up/pull-down enable register. */
-        switch (port)
+        PCAL6524_ServiceRetries();
+        if ((HAL_GetTick() - tickstart) > PCAL6524_I2C_TIMEOUT)
         {
-        case 0:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_PULL_EN_PORT_0, &data);
-            break;
-        case 1:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_PULL_EN_PORT_1, &data);
-            break;
-        case 2:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_PULL_EN_PORT_2, &data);
-            break;
-        }
-        if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
+            PCAL6524_AbortActive();
+            tickstart = HAL_GetTick();
         }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
-            return HAL_ERROR;
+    }
+    return wait.status;
+}
+
+uint8_t PCAL6524_ReadI2C(pcal6524_Device_t *device, uint8_t regAdress, uint8_t *data, uint16_t len)
+{
+    pcal6524_Request_t request = {device, regAdress, 1, data, len, NULL, NULL, 0, 0, 0, 0};
+    return PCAL6524_Transfer(&request);
+}
+
+uint8_t PCAL6524_WriteI2C(pcal6524_Device_t *device, uint8_t regAdress, uint8_t *data, uint16_t len)
+{
+    pcal6524_Request_t request = {device, regAdress, 0, data, len, NULL, NULL, 0, 0, 0, 0};
+    return PCAL6524_Transfer(&request);
+}
+
+static uint8_t PCAL6524_TransferAsync(pcal6524_Request_t *request)
+{
+    if ((request->command & ~PCAL6524_AUTO_INCREMENT) >= PCAL6524_REG_MAP_SIZE || request->len == 0 || request->data == NULL)
+    { // Checks for input errors.
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    if (request->device->health.state == PCAL6524_HealthOffline)
+    { // Fails fast until the probe finds the device again.
+        return PCAL6524_DEVICEOFFLINE;
+    }
+    request->reschedule = 1;
+    return PCAL6524_Submit(request);
+}
+
+uint8_t PCAL6524_ReadAsync(pcal6524_Device_t *device, uint8_t reg, uint8_t *data, uint16_t len, pcal6524_Callback_t callback, void *context)
+{
+    pcal6524_Request_t request = {device, reg, 1, data, len, callback, context, 0, 0, 0, 0};
+    if (reg >= PCAL6524_REG_MAP_SIZE)
+    { // Checks for input errors.
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    if (len > 1)
+    { // Reads consecutive registers in one transaction.
+        request.command |= PCAL6524_AUTO_INCREMENT;
+    }
+    return PCAL6524_TransferAsync(&request);
+}
+
+uint8_t PCAL6524_WriteAsync(pcal6524_Device_t *device, uint8_t reg, uint8_t *data, uint16_t len, pcal6524_Callback_t callback, void *context)
+{
+    pcal6524_Request_t request = {device, reg, 0, data, len, callback, context, 0, 0, 0, 0};
+    if (reg >= PCAL6524_REG_MAP_SIZE)
+    { // Checks for input errors.
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    if (len > 1)
+    { // Writes consecutive registers in one transaction.
+        request.command |= PCAL6524_AUTO_INCREMENT;
+    }
+    return PCAL6524_TransferAsync(&request);
+}
+
+uint8_t PCAL6524_StreamOutputsAsync(pcal6524_Device_t *device, pcal6524_Port_t port, const uint8_t *frames, uint16_t n, pcal6524_Callback_t callback, void *context)
+{
+    /* Without the auto-increment flag every data byte lands in the same output register. */
+    pcal6524_Request_t request = {device, PCAL6524_REG_OUT_PORT_0 + port, 0, (uint8_t *)frames, n, callback, context, 0, 0, 0, 0};
+    if (port > 2)
+    { // Checks for input errors.
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    if (device->batchActive || PCAL6524_RegBit(device->shadowDirty, PCAL6524_REG_OUT_PORT_0 + port))
+    { // The pending value would be committed over the last frame.
+        return HAL_BUSY;
+    }
+    return PCAL6524_TransferAsync(&request);
+}
+
+uint8_t PCAL6524_IsBusy(pcal6524_Device_t *device)
+{
+    uint8_t busy = 0;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    busy = PCAL6524_ActiveBusy && PCAL6524_Active.device == device;
+    for (uint8_t i = 0; i < PCAL6524_QueueCount && !busy; i++)
+    {
+        busy = PCAL6524_Queue[(PCAL6524_QueueHead + i) % PCAL6524_QUEUE_SIZE].device == device;
+    }
+    __set_PRIMASK(primask);
+    return busy;
+}
+
+void PCAL6524_I2C_TransferCallback(I2C_HandleTypeDef *hi2c, uint8_t status)
+{
+    if (PCAL6524_ActiveBusy && PCAL6524_Active.device->hi2c == hi2c)
+    {
+        PCAL6524_CompleteTransfer(status);
+    }
+}
+
+#ifndef PCAL6524_NO_HAL_CALLBACKS
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+    PCAL6524_I2C_TransferCallback(hi2c, HAL_OK);
+}
+
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+    PCAL6524_I2C_TransferCallback(hi2c, HAL_OK);
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+    PCAL6524_I2C_TransferCallback(hi2c, HAL_ERROR);
+}
+#endif
+
+static uint8_t PCAL6524_Retry(pcal6524_Request_t *request)
+{
+    pcal6524_Device_t *device = request->device;
+    uint8_t status = 0;  // Holds i2c status for error catching.
+    uint32_t start = PCAL6524_Cycles();
+    uint32_t delay = 0;  // Wait before the next attempt [us].
+    if (device->health.state == PCAL6524_HealthOffline)
+    { // Fails fast until the probe finds the device again.
+        return PCAL6524_DEVICEOFFLINE;
+    }
+    /* Repeats i2c call, in case of busy i2c unit. */
+    for (uint8_t attempt = 1;; attempt++)
+    {
+        status = PCAL6524_Transfer(request);
+        if (status == HAL_OK || !PCAL6524_NextRetry(device, status, attempt, start, &delay))
+        { // Returns on success, on errors not worth repeating and when the policy gives up.
+            PCAL6524_CountRetryResult(device, status, attempt);
+            PCAL6524_RecordHealth(device, status);
+            return status;
         }
-        else
+        device->retryStats.retries++;
+        device->retryStats.waitUs += delay;
+        PCAL6524_DelayUs(delay);
+    }
+}
+
+static uint8_t PCAL6524_ReadRegisters(pcal6524_Device_t *device, uint8_t reg, uint8_t *data, uint16_t len)
+{
+    pcal6524_Request_t request = {device, reg, 1, data, len, NULL, NULL, 0, 0, 0, 0};
+    if (len > 1)
+    { // Reads consecutive registers in one transaction.
+        request.command |= PCAL6524_AUTO_INCREMENT;
+    }
+    return PCAL6524_Retry(&request);
+}
+
+static uint8_t PCAL6524_WriteRegisters(pcal6524_Device_t *device, uint8_t reg, uint8_t *data, uint16_t len)
+{
+    pcal6524_Request_t request = {device, reg, 0, data, len, NULL, NULL, 0, 0, 0, 0};
+    if (len > 1)
+    { // Writes consecutive registers in one transaction.
+        request.command |= PCAL6524_AUTO_INCREMENT;
+    }
+    return PCAL6524_Retry(&request);
+}
+
+static uint8_t PCAL6524_GetShadow(pcal6524_Device_t *device, uint8_t reg, uint8_t *value)
+{
+    uint8_t status = 0; // Holds i2c status for error catching.
+    if (!PCAL6524_RegBit(device->shadowValid, reg))
+    { // Falls back to the chip when the register was never cached.
+        status = PCAL6524_ReadRegisters(device, reg, &device->shadow[reg], 1);
+        if (status > HAL_OK)
         {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
+            return status;
         }
+        PCAL6524_SetRegBit(device->shadowValid, reg, 1);
     }
-    /* Catches case when all attempts failed and returns last error code. */
+    *value = device->shadow[reg];
+    return PCAL6524_SUCCESS;
+}
+
+static uint8_t PCAL6524_UpdateShadow(pcal6524_Device_t *device, uint8_t reg, uint8_t mask, uint8_t bits)
+{
+    uint8_t data = 0;   // Holds data for i2c communication.
+    uint8_t status = 0; // Holds i2c status for error catching.
+    status = PCAL6524_GetShadow(device, reg, &data);
     if (status > HAL_OK)
     {
         return status;
     }
     /* Combines current value of register with value that has to be changed. */
-    data = (data & (~(0b1 << pin))) | (active << pin);
-    /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
+    data = (data & ~mask) | (bits & mask);
+    if (data == device->shadow[reg])
+    { // Skips the transaction when the chip already holds the value.
+        return PCAL6524_SUCCESS;
+    }
+    if (device->batchActive)
+    { // Defers the write to PCAL6524_CommitBatch.
+        PCAL6524_SetRegBit(device->shadowDirty, reg, 1);
+        PCAL6524_MergeShadow(device, reg, mask, bits);
+        device->batchChanges++;
+        return PCAL6524_SUCCESS;
+    }
+    status = PCAL6524_WriteRegisters(device, reg, &data, 1);
+    if (status == PCAL6524_DEVICEOFFLINE)
+    { // Nothing was sent, the value stays pending for the replay after recovery.
+        PCAL6524_SetRegBit(device->shadowDirty, reg, 1);
+        PCAL6524_MergeShadow(device, reg, mask, bits);
+        return status;
+    }
+    if (status > HAL_OK)
+    { // Chip state is unknown after a failed write, so it is re-read on next access.
+        PCAL6524_SetRegBit(device->shadowValid, reg, 0);
+        return status;
+    }
+    PCAL6524_MergeShadow(device, reg, mask, bits);
+    return PCAL6524_SUCCESS;
+}
+
+static uint8_t PCAL6524_FetchShadowRange(pcal6524_Device_t *device, uint8_t reg, uint8_t count)
+{
+    uint8_t data[PCAL6524_MAX_RANGE]; // Holds data for i2c communication.
+    uint8_t status = 0;               // Holds i2c status for error catching.
+    for (uint8_t i = 0; i < count; i++)
     {
-        /* Sends changed setting in pull-up/pull-down enable register to chip. */
-        switch (port)
-        {
-        case 0:
-            status = PCAL6524_WriteI2C(device, PCAL6524_REG_PULL_EN_PORT_0, &data);
-            break;
-        case 1:
-            status = PCAL6524_WriteI2C(device, PCAL6524_REG_PULL_EN_PORT_1, &data);
-            break;
-        case 2:
-            status = PCAL6524_WriteI2C(device, PCAL6524_REG_PULL_EN_PORT_2, &data);
+        if (!PCAL6524_RegBit(device->shadowValid, reg + i))
+        { // Fetches the whole range once if any register was never cached.
+            status = PCAL6524_ReadRegisters(device, reg, data, count);
+            if (status > HAL_OK)
+            {
+                return status;
+            }
+            for (uint8_t j = 0; j < count; j++)
+            { // Cached registers keep their value, it may hold batch changes or pin marks not sent yet.
+                if (!PCAL6524_RegBit(device->shadowValid, reg + j))
+                {
+                    PCAL6524_StoreShadow(device, reg + j, data[j]);
+                    PCAL6524_SetRegBit(device->shadowValid, reg + j, 1);
+                }
+            }
             break;
         }
-        if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
+    }
+    return PCAL6524_SUCCESS;
+}
+
+static uint8_t PCAL6524_UpdateShadowRange(pcal6524_Device_t *device, uint8_t reg, uint8_t count, const uint8_t *mask, const uint8_t *bits)
+{
+    uint8_t data[PCAL6524_MAX_RANGE]; // Holds data for i2c communication.
+    uint8_t status = 0;               // Holds i2c status for error catching.
+    uint8_t first = count;            // First register that changes.
+    uint8_t last = 0;                 // Last register that changes.
+    if (count > PCAL6524_MAX_RANGE)
+    { // Checks for input errors.
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    status = PCAL6524_FetchShadowRange(device, reg, count);
+    if (status > HAL_OK)
+    {
+        return status;
+    }
+    /* Combines current value of registers with values that have to be changed. */
+    for (uint8_t i = 0; i < count; i++)
+    {
+        data[i] = (device->shadow[reg + i] & ~mask[i]) | (bits[i] & mask[i]);
+        if (data[i] != device->shadow[reg + i])
+        {
+            if (first == count)
+            {
+                first = i;
+            }
+            last = i;
+        }
+    }
+    if (first == count)
+    { // Skips the transaction when the chip already holds all values.
+        return PCAL6524_SUCCESS;
+    }
+    if (device->batchActive)
+    { // Defers the write to PCAL6524_CommitBatch.
+        for (uint8_t i = first; i <= last; i++)
+        {
+            if (data[i] != device->shadow[reg + i])
+            {
+                PCAL6524_SetRegBit(device->shadowDirty, reg + i, 1);
+                PCAL6524_MergeShadow(device, reg + i, mask[i], bits[i]);
+                device->batchChanges++;
+            }
+        }
+        return PCAL6524_SUCCESS;
+    }
+    /* Writes the changed span in one transaction; unchanged registers inside it get their own value. */
+    status = PCAL6524_WriteRegisters(device, reg + first, &data[first], last - first + 1);
+    if (status == PCAL6524_DEVICEOFFLINE)
+    { // Nothing was sent, the values stay pending for the replay after recovery.
+        for (uint8_t i = first; i <= last; i++)
+        {
+            if (mask[i] != 0)
+            {
+                PCAL6524_SetRegBit(device->shadowDirty, reg + i, 1);
+                PCAL6524_MergeShadow(device, reg + i, mask[i], bits[i]);
+            }
         }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
+        return status;
+    }
+    if (status > HAL_OK)
+    { // Chip state is unknown after a failed write, so it is re-read on next access.
+        for (uint8_t i = first; i <= last; i++)
+        {
+            PCAL6524_SetRegBit(device->shadowValid, reg + i, 0);
+        }
+        return status;
+    }
+    for (uint8_t i = first; i <= last; i++)
+    {
+        PCAL6524_MergeShadow(device, reg + i, mask[i], bits[i]);
+    }
+    return PCAL6524_SUCCESS;
+}
+
+static uint8_t PCAL6524_RestoreShadow(pcal6524_Device_t *device)
+{
+    uint8_t data[PCAL6524_RETAINED_CHECK_LAST - PCAL6524_RETAINED_CHECK_FIRST + 1]; // Registers read back.
+    uint8_t slot = PCAL6524_FindRetained(device, 0);
+    uint8_t status = 0; // Holds i2c status for error catching.
+    if (slot == PCAL6524_RETAINED_DEVICES || PCAL6524_Retained[slot].checksum != PCAL6524_RetainedSum(slot))
+    { // Cold start: retained RAM holds no image of this device.
+        return HAL_ERROR;
+    }
+    status = PCAL6524_ReadRegisters(device, PCAL6524_RETAINED_CHECK_FIRST, data, sizeof(data));
+    if (status > HAL_OK)
+    {
+        return status;
+    }
+    for (uint8_t reg = PCAL6524_RETAINED_CHECK_FIRST; reg <= PCAL6524_RETAINED_CHECK_LAST; reg++)
+    {
+        if (PCAL6524_RegBit(PCAL6524_WritableMap, reg) && PCAL6524_RegBit(PCAL6524_Retained[slot].valid, reg) &&
+            data[reg - PCAL6524_RETAINED_CHECK_FIRST] != PCAL6524_Retained[slot].shadow[reg])
+        { // Chip was reset or changed meanwhile.
+            PCAL6524_Retained[slot].magic = 0;
             return HAL_ERROR;
         }
-        else
+    }
+    for (uint8_t reg = 0; reg < PCAL6524_REG_MAP_SIZE; reg++)
+    { // Registers of failed writes stay invalid and are read from the chip on first use.
+        if (PCAL6524_RegBit(PCAL6524_Retained[slot].valid, reg))
+        {
+            device->shadow[reg] = PCAL6524_Retained[slot].shadow[reg];
+            PCAL6524_SetRegBit(device->shadowValid, reg, 1);
+        }
+    }
+    return PCAL6524_SUCCESS;
+}
+
+uint8_t PCAL6524_Init(pcal6524_Device_t *device)
+{
+    /* Keeps never written slots at zero, so they can serve as gap bytes of a burst. */
+    memset(device->shadow, 0, sizeof(device->shadow));
+    device->batchActive = 0;
+    if (device->retry.maxAttempts == 0)
+    {
+        device->retry = (pcal6524_RetryPolicy_t)PCAL6524_RETRY_POLICY_DEFAULT;
+    }
+    memset(&device->retryStats, 0, sizeof(device->retryStats));
+    memset(&device->health, 0, sizeof(device->health));
+    memset(&device->inputCache, 0, sizeof(device->inputCache));
+    PCAL6524_StartCycleCounter();
+    PCAL6524_InvalidateShadow(device);
+    device->restored = (PCAL6524_RestoreShadow(device) == HAL_OK);
+    if (device->restored)
+    { // Warm restart, the chip still holds the configuration.
+        return PCAL6524_SUCCESS;
+    }
+    return PCAL6524_RefreshShadow(device);
+}
+
+uint8_t PCAL6524_RefreshShadow(pcal6524_Device_t *device)
+{
+    uint8_t status = 0; // Holds i2c status for error catching.
+    for (uint8_t i = 0; i < sizeof(PCAL6524_ShadowBlocks) / sizeof(PCAL6524_ShadowBlocks[0]); i++)
+    {
+        uint8_t reg = PCAL6524_ShadowBlocks[i][0];
+        uint8_t len = PCAL6524_ShadowBlocks[i][1];
+        status = PCAL6524_ReadRegisters(device, reg, &device->shadow[reg], len);
+        for (uint8_t j = 0; j < len; j++)
+        {
+            PCAL6524_SetRegBit(device->shadowValid, reg + j, status == HAL_OK);
+        }
+        if (status > HAL_OK)
         {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
+            return status;
         }
     }
-    /* Catches case when all attempts failed and returns last error code. */
+    PCAL6524_Retain(device);
+    return PCAL6524_SUCCESS; // Returns success code when transmission successful.
+}
+
+void PCAL6524_InvalidateShadow(pcal6524_Device_t *device)
+{
+    memset(device->shadowValid, 0, sizeof(device->shadowValid));
+    memset(device->shadowDirty, 0, sizeof(device->shadowDirty));
+}
+
+void PCAL6524_BeginBatch(pcal6524_Device_t *device)
+{
+    if (!device->batchActive)
+    {
+        device->batchActive = 1;
+        device->batchChanges = 0;
+    }
+}
+
+uint8_t PCAL6524_CommitBatch(pcal6524_Device_t *device)
+{
+    pcal6524_BatchStats_t stats = {0}; // Statistics of this commit.
+    uint8_t status = 0;                // Holds i2c status for error catching.
+    uint8_t start = 0;                 // First register of current burst.
+    uint8_t end = 0;                   // Last register of current burst.
+    uint32_t changeBytes = 0;          // Bus bytes of writing each recorded change on its own.
+    device->batchActive = 0;
+    while (start < PCAL6524_REG_MAP_SIZE)
+    {
+        if (!PCAL6524_RegBit(device->shadowDirty, start))
+        {
+            start++;
+            continue;
+        }
+        /* Extends the burst over gaps that cost less than starting a new transaction. */
+        end = start;
+        for (uint8_t next = start + 1; next < PCAL6524_REG_MAP_SIZE && next - end - 1 <= PCAL6524_TRANSACTION_OVERHEAD; next++)
+        {
+            if (!PCAL6524_IsBridgeable(device, next))
+            {
+                break;
+            }
+            if (PCAL6524_RegBit(device->shadowDirty, next))
+            {
+                end = next;
+            }
+        }
+        /* Clears the marks before sending, so a pin marked meanwhile keeps its register pending. */
+        for (uint8_t reg = start; reg <= end; reg++)
+        {
+            PCAL6524_SetRegBit(device->shadowDirty, reg, 0);
+        }
+        status = PCAL6524_WriteRegisters(device, start, &device->shadow[start], end - start + 1);
+        if (status > HAL_OK)
+        { // Later registers stay pending. The burst is pending again if nothing was sent, unknown otherwise.
+            for (uint8_t reg = start; reg <= end; reg++)
+            {
+                if (status == PCAL6524_DEVICEOFFLINE)
+                {
+                    PCAL6524_SetRegBit(device->shadowDirty, reg, PCAL6524_RegBit(PCAL6524_WritableMap, reg) && PCAL6524_RegBit(device->shadowValid, reg));
+                }
+                else
+                {
+                    PCAL6524_SetRegBit(device->shadowValid, reg, 0);
+                }
+            }
+            device->batchChanges = 0;
+            return status;
+        }
+        stats.transactions++;
+        stats.bytes += end - start + 1 + PCAL6524_TRANSACTION_OVERHEAD;
+        start = end + 1;
+    }
+    /* Compares against one transaction per recorded change. Pin marks are not counted, since a counter
+     * shared with interrupt code would need the critical section marks avoid, so the savings stop at zero. */
+    changeBytes = device->batchChanges * (1U + PCAL6524_TRANSACTION_OVERHEAD);
+    stats.transactionsSaved = (device->batchChanges > stats.transactions) ? device->batchChanges - stats.transactions : 0;
+    stats.bytesSaved = (changeBytes > stats.bytes) ? changeBytes - stats.bytes : 0;
+    device->batchStats = stats;
+    device->batchChanges = 0;
+    return PCAL6524_SUCCESS; // Returns success code when transmission successful.
+}
+
+#if defined(STM32F1)
+/**
+ * @brief Bus speeds tried by the negotiation, fastest first.
+ */
+static const struct
+{
+    uint32_t clockSpeed;
+    uint32_t dutyCycle;
+} PCAL6524_BusSpeeds[] = {
+    {400000, I2C_DUTYCYCLE_16_9}, // Fast mode.
+    {100000, I2C_DUTYCYCLE_2},    // Standard mode.
+};
+
+#define PCAL6524_BUS_SPEED_COUNT (sizeof(PCAL6524_BusSpeeds) / sizeof(PCAL6524_BusSpeeds[0]))
+
+static uint8_t PCAL6524_SetBusSpeed(pcal6524_Device_t *device, uint8_t level)
+{
+    I2C_HandleTypeDef *hi2c = device->hi2c;
+    uint8_t status = 0; // Holds i2c status for error catching.
+    uint32_t ccr = 0;   // Clock control register after init.
+    PCAL6524_WaitBusIdle();
+    hi2c->Init.ClockSpeed = PCAL6524_BusSpeeds[level].clockSpeed;
+    hi2c->Init.DutyCycle = PCAL6524_BusSpeeds[level].dutyCycle;
+    status = HAL_I2C_Init(hi2c); // Pins and DMA stay configured, only the timing changes.
+    /* Reports the frequency the clock divider actually gives, HAL rounds it down. */
+    ccr = hi2c->Instance->CCR;
+    device->busSpeed.clockSpeed = HAL_RCC_GetPCLK1Freq() /
+                                  ((ccr & I2C_CCR_CCR) * ((ccr & I2C_CCR_FS) ? ((ccr & I2C_CCR_DUTY) ? 25 : 3) : 2));
+    device->busSpeed.level = level;
+    device->busSpeed.errors = 0;
+    device->busSpeed.windowStart = HAL_GetTick();
+    return status;
+}
+
+static uint8_t PCAL6524_VerifyLink(pcal6524_Device_t *device)
+{
+    uint8_t data[3];     // Holds data for i2c communication.
+    uint8_t errors = 0;  // Failed or wrong reads.
+    pcal6524_Request_t request = {device, PCAL6524_REG_CONF_PORT_0 | PCAL6524_AUTO_INCREMENT, 1, data, sizeof(data), NULL, NULL, 0, 0, 0, 0};
+    for (uint8_t i = 0; i < PCAL6524_LINK_CHECK_READS; i++)
+    { // Single attempts, retries would hide a bad link.
+        if (PCAL6524_Transfer(&request) > HAL_OK || memcmp(data, &device->shadow[PCAL6524_REG_CONF_PORT_0], sizeof(data)) != 0)
+        {
+            errors++;
+        }
+    }
+    return errors;
+}
+
+uint8_t PCAL6524_NegotiateBusSpeed(pcal6524_Device_t *device)
+{
+    uint8_t data = 0;   // Holds data for i2c communication.
+    uint8_t status = 0; // Holds i2c status for error catching.
+    for (uint8_t reg = PCAL6524_REG_CONF_PORT_0; reg <= PCAL6524_REG_CONF_PORT_2; reg++)
+    { // Makes sure the reference values are known.
+        status = PCAL6524_GetShadow(device, reg, &data);
+        if (status > HAL_OK)
+        {
+            return status;
+        }
+    }
+    for (uint8_t level = 0; level < PCAL6524_BUS_SPEED_COUNT; level++)
+    {
+        if (PCAL6524_SetBusSpeed(device, level) == HAL_OK && PCAL6524_VerifyLink(device) == 0)
+        {
+            return PCAL6524_SUCCESS;
+        }
+    }
+    return HAL_ERROR;
+}
+#endif
+
+static uint8_t PCAL6524_ReplayShadow(pcal6524_Device_t *device)
+{
+    /* Marks every known register, so the commit writes the whole image in as few transactions as possible. */
+    if (!device->batchActive)
+    {
+        device->batchChanges = 0;
+    }
+    for (uint8_t i = 0; i < sizeof(PCAL6524_ShadowBlocks) / sizeof(PCAL6524_ShadowBlocks[0]); i++)
+    {
+        for (uint8_t reg = PCAL6524_ShadowBlocks[i][0]; reg < PCAL6524_ShadowBlocks[i][0] + PCAL6524_ShadowBlocks[i][1]; reg++)
+        {
+            if (PCAL6524_RegBit(device->shadowValid, reg) && !PCAL6524_RegBit(device->shadowDirty, reg))
+            {
+                PCAL6524_SetRegBit(device->shadowDirty, reg, 1);
+                device->batchChanges++;
+            }
+        }
+    }
+    if (device->batchActive)
+    { // Open batch writes the registers with its commit.
+        return PCAL6524_SUCCESS;
+    }
+    return PCAL6524_CommitBatch(device);
+}
+
+static inline uint8_t PCAL6524_IsResetWatchable(pcal6524_Device_t *device, uint8_t reg)
+{
+    for (uint8_t i = 0; i < sizeof(PCAL6524_ShadowBlocks) / sizeof(PCAL6524_ShadowBlocks[0]); i++)
+    {
+        if (reg >= PCAL6524_ShadowBlocks[i][0] && reg < PCAL6524_ShadowBlocks[i][0] + PCAL6524_ShadowBlocks[i][1])
+        { // Known, written value that differs from the power-on value.
+            return PCAL6524_RegBit(device->shadowValid, reg) && !PCAL6524_RegBit(device->shadowDirty, reg) &&
+                   device->shadow[reg] != PCAL6524_ShadowBlocks[i][2];
+        }
+    }
+    return 0;
+}
+
+uint8_t PCAL6524_ServiceHealth(pcal6524_Device_t *device)
+{
+    uint8_t data = 0; // Holds data for i2c communication.
+    pcal6524_Request_t probe = {device, PCAL6524_REG_IN_STATUS_PORT_0, 1, &data, 1, NULL, NULL, 0, 0, 0, 0};
+    if (device->health.state == PCAL6524_HealthOnline)
+    {
+#if defined(STM32F1)
+        if ((HAL_GetTick() - device->busSpeed.windowStart) >= PCAL6524_BREAKER_COOLDOWN)
+        { // Steps down a speed when errors rise on a negotiated bus.
+            if (device->busSpeed.clockSpeed > 0 && device->busSpeed.errors >= PCAL6524_BUS_ERROR_LIMIT &&
+                device->busSpeed.level < PCAL6524_BUS_SPEED_COUNT - 1)
+            {
+                return PCAL6524_SetBusSpeed(device, device->busSpeed.level + 1);
+            }
+            device->busSpeed.errors = 0;
+            device->busSpeed.windowStart = HAL_GetTick();
+        }
+#endif
+        return PCAL6524_SUCCESS;
+    }
+    if ((HAL_GetTick() - device->health.since) < PCAL6524_BREAKER_COOLDOWN)
+    {
+        return PCAL6524_DEVICEOFFLINE;
+    }
+    /* Single read without side effects, no retries. */
+    device->health.since = HAL_GetTick();
+    if (PCAL6524_Transfer(&probe) > HAL_OK)
+    {
+        return PCAL6524_DEVICEOFFLINE;
+    }
+    device->health.state = PCAL6524_HealthOnline;
+    device->health.failures = 0;
+    device->health.recoveries++;
+    /* The chip may have been reset during the outage. */
+    return PCAL6524_ReplayShadow(device);
+}
+
+uint8_t PCAL6524_ServiceReset(pcal6524_Device_t *device)
+{
+    uint8_t data = 0;                       // Holds data for i2c communication.
+    uint8_t status = 0;                     // Holds i2c status for error catching.
+    uint8_t reg = device->health.watchReg;  // Register compared with the shadow image.
+    if (device->health.state == PCAL6524_HealthOffline)
+    { // PCAL6524_ServiceHealth replays the image when the device returns.
+        return PCAL6524_DEVICEOFFLINE;
+    }
+    if ((HAL_GetTick() - device->health.watchTick) < PCAL6524_RESET_CHECK_INTERVAL)
+    {
+        return PCAL6524_SUCCESS;
+    }
+    device->health.watchTick = HAL_GetTick();
+    if (reg == 0 || !PCAL6524_IsResetWatchable(device, reg))
+    { // Picks a register that a reset would change, the configuration may have moved on.
+        reg = 0;
+        for (uint8_t i = 0; i < sizeof(PCAL6524_ShadowBlocks) / sizeof(PCAL6524_ShadowBlocks[0]) && reg == 0; i++)
+        {
+            for (uint8_t j = 0; j < PCAL6524_ShadowBlocks[i][1]; j++)
+            {
+                if (PCAL6524_IsResetWatchable(device, PCAL6524_ShadowBlocks[i][0] + j))
+                {
+                    reg = PCAL6524_ShadowBlocks[i][0] + j;
+                    break;
+                }
+            }
+        }
+        device->health.watchReg = reg;
+    }
+    if (reg == 0)
+    { // Every known register holds its power-on value, a reset would change nothing.
+        return PCAL6524_SUCCESS;
+    }
+    status = PCAL6524_ReadRegisters(device, reg, &data, 1);
+    if (status > HAL_OK || data == device->shadow[reg])
+    {
+        return status;
+    }
+    device->health.resets++;
+    return PCAL6524_ReplayShadow(device);
+}
+
+static void PCAL6524_StageRegister(pcal6524_Device_t *device, uint8_t reg, uint8_t value)
+{
+    if (PCAL6524_RegBit(device->shadowValid, reg) && device->shadow[reg] == value)
+    { // Skips registers the chip already holds.
+        return;
+    }
+    device->shadow[reg] = value;
+    PCAL6524_SetRegBit(device->shadowValid, reg, 1);
+    PCAL6524_SetRegBit(device->shadowDirty, reg, 1);
+    device->batchChanges++;
+}
+
+static void PCAL6524_LoadConfig(pcal6524_Device_t *device, const pcal6524_Config_t *config)
+{ // Takes a configuration as known chip content.
+    for (uint8_t port = 0; port < 3; port++)
+    {
+        device->shadow[PCAL6524_REG_OUT_PORT_0 + port] = (uint8_t)(config->output >> (8 * port));
+        device->shadow[PCAL6524_REG_POL_PORT_0 + port] = (uint8_t)(config->polarity >> (8 * port));
+        device->shadow[PCAL6524_REG_CONF_PORT_0 + port] = (uint8_t)(config->direction >> (8 * port));
+        device->shadow[PCAL6524_REG_IN_LATCH_PORT_0 + port] = (uint8_t)(config->inputLatch >> (8 * port));
+        device->shadow[PCAL6524_REG_PULL_EN_PORT_0 + port] = (uint8_t)(config->pullEnable >> (8 * port));
+        device->shadow[PCAL6524_REG_PULL_SEL_PORT_0 + port] = (uint8_t)(config->pullSelect >> (8 * port));
+        device->shadow[PCAL6524_REG_INT_MASK_PORT_0 + port] = (uint8_t)(config->interruptMask >> (8 * port));
+    }
+    for (uint8_t i = 0; i < 6; i++)
+    {
+        device->shadow[PCAL6524_REG_INT_EGDE_PORT_0A + i] = (uint8_t)(config->edge >> (8 * i));
+    }
+    for (uint8_t i = 0; i < sizeof(PCAL6524_ShadowBlocks) / sizeof(PCAL6524_ShadowBlocks[0]); i++)
+    {
+        for (uint8_t j = 0; j < PCAL6524_ShadowBlocks[i][1]; j++)
+        {
+            PCAL6524_SetRegBit(device->shadowValid, PCAL6524_ShadowBlocks[i][0] + j, 1);
+        }
+    }
+}
+
+static uint8_t PCAL6524_CommitPhase(pcal6524_Device_t *device, pcal6524_BatchStats_t *total)
+{
+    uint8_t status = PCAL6524_CommitBatch(device); // Holds i2c status for error catching.
+    total->transactions += device->batchStats.transactions;
+    total->transactionsSaved += device->batchStats.transactionsSaved;
+    total->bytes += device->batchStats.bytes;
+    total->bytesSaved += device->batchStats.bytesSaved;
+    return status;
+}
+
+uint8_t PCAL6524_ApplyConfig(pcal6524_Device_t *device, const pcal6524_Config_t *config, const pcal6524_Config_t *previous)
+{
+    pcal6524_BatchStats_t total = {0}; // Statistics summed over all phases.
+    uint8_t status = 0;                // Holds i2c status for error catching.
+    uint8_t mask = 0;                  // Interrupt mask while pins are reconfigured.
+    if (device->batchActive)
+    { // The phases commit on their own and would send and close the caller's batch early.
+        return HAL_BUSY;
+    }
+    if (previous != NULL)
+    {
+        PCAL6524_LoadConfig(device, previous);
+    }
+    /* Phase 1: values that only act once pins are switched, with new interrupts still masked. */
+    PCAL6524_BeginBatch(device);
+    for (uint8_t port = 0; port < 3; port++)
+    {
+        PCAL6524_StageRegister(device, PCAL6524_REG_OUT_PORT_0 + port, (uint8_t)(config->output >> (8 * port)));
+        PCAL6524_StageRegister(device, PCAL6524_REG_POL_PORT_0 + port, (uint8_t)(config->polarity >> (8 * port)));
+        PCAL6524_StageRegister(device, PCAL6524_REG_PULL_SEL_PORT_0 + port, (uint8_t)(config->pullSelect >> (8 * port)));
+        PCAL6524_StageRegister(device, PCAL6524_REG_IN_LATCH_PORT_0 + port, (uint8_t)(config->inputLatch >> (8 * port)));
+        mask = (uint8_t)(config->interruptMask >> (8 * port));
+        if (PCAL6524_RegBit(device->shadowValid, PCAL6524_REG_INT_MASK_PORT_0 + port))
+        { // Keeps currently masked pins masked until the last phase.
+            mask |= device->shadow[PCAL6524_REG_INT_MASK_PORT_0 + port];
+        }
+        else
+        { // Mask on chip is unknown, so all pins stay masked until the last phase.
+            mask = 0xFF;
+        }
+        PCAL6524_StageRegister(device, PCAL6524_REG_INT_MASK_PORT_0 + port, mask);
+    }
+    for (uint8_t i = 0; i < 6; i++)
+    {
+        PCAL6524_StageRegister(device, PCAL6524_REG_INT_EGDE_PORT_0A + i, (uint8_t)(config->edge >> (8 * i)));
+    }
+    status = PCAL6524_CommitPhase(device, &total);
+    if (status > HAL_OK)
+    {
+        return status;
+    }
+    /* Phase 2: pulls and direction; outputs start driving the latch written before. */
+    PCAL6524_BeginBatch(device);
+    for (uint8_t port = 0; port < 3; port++)
+    {
+        PCAL6524_StageRegister(device, PCAL6524_REG_PULL_EN_PORT_0 + port, (uint8_t)(config->pullEnable >> (8 * port)));
+        PCAL6524_StageRegister(device, PCAL6524_REG_CONF_PORT_0 + port, (uint8_t)(config->direction >> (8 * port)));
+    }
+    status = PCAL6524_CommitPhase(device, &total);
+    if (status > HAL_OK)
+    {
+        return status;
+    }
+    /* Phase 3: final interrupt mask. */
+    PCAL6524_BeginBatch(device);
+    for (uint8_t port = 0; port < 3; port++)
+    {
+        PCAL6524_StageRegister(device, PCAL6524_REG_INT_MASK_PORT_0 + port, (uint8_t)(config->interruptMask >> (8 * port)));
+    }
+    status = PCAL6524_CommitPhase(device, &total);
+    device->batchStats = total;
+    return status;
+}
+
+uint8_t PCAL6524_SetInOut(pcal6524_Device_t *device, pcal6524_Port_t port, pcal6524_Pin_t pin, pcal6524_InOut_t io)
+{
+    if (port > 2 || pin > 7 || io > 1)
+    { // Checks for input errors.
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    return PCAL6524_UpdateShadow(device, PCAL6524_REG_CONF_PORT_0 + port, 1 << pin, io << pin);
+}
+uint8_t PCAL6524_GetInOutConfig(pcal6524_Device_t *device, pcal6524_Port_t port, uint8_t *ios)
+{
+    if (port > 2)
+    { // Checks for input errors.
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    return PCAL6524_GetShadow(device, PCAL6524_REG_CONF_PORT_0 + port, ios);
+}
+uint8_t PCAL6524_SetInterrupt(
+    pcal6524_Device_t *device, pcal6524_Port_t port,
+    pcal6524_Pin_t pin, pcal6524_InterruptEN_t intr)
+{
+    /* Checks for input errors. */
+    if (port > 2 || pin > 7 || intr > 1)
+    {
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    /* Mask register is active high, so a set bit disables the interrupt. */
+    return PCAL6524_UpdateShadow(device, PCAL6524_REG_INT_MASK_PORT_0 + port, 1 << pin, (!intr) << pin);
+}
+uint8_t PCAL6524_GetInterruptConfig(
+    pcal6524_Device_t *device, pcal6524_Port_t port,
+    uint8_t *intr)
+{
+    if (port > 2)
+    { // Checks for input errors.
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    return PCAL6524_GetShadow(device, PCAL6524_REG_INT_MASK_PORT_0 + port, intr);
+}
+uint8_t PCAL6524_SetPullupDown(
+    pcal6524_Device_t *device, pcal6524_Port_t port,
+    pcal6524_Pin_t pin, pcal6524_PullUpDown_t pull,
+    pcal6524_PullUpDownEN_t active)
+{
+    uint8_t status = 0; // Holds i2c status for error catching.
+    /* Checks for input errors. */
+    if (port > 2 || pin > 7 || pull > 1 || active > 1)
+    {
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    /* Selects pull direction before the resistor gets connected. */
+    status = PCAL6524_UpdateShadow(device, PCAL6524_REG_PULL_SEL_PORT_0 + port, 1 << pin, pull << pin);
+    if (status > HAL_OK)
+    {
+        return status;
+    }
+    return PCAL6524_UpdateShadow(device, PCAL6524_REG_PULL_EN_PORT_0 + port, 1 << pin, active << pin);
+}
+uint8_t PCAL6524_GetPullupDownConfig(
+    pcal6524_Device_t *device, pcal6524_Port_t port,
+    uint8_t *pull, uint8_t *active)
+{
+    uint8_t status = 0; // Holds i2c status for error catching.
+    if (port > 2)
+    { // Checks for input errors.
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    status = PCAL6524_GetShadow(device, PCAL6524_REG_PULL_SEL_PORT_0 + port, pull);
+    if (status > HAL_OK)
+    {
+        return status;
+    }
+    return PCAL6524_GetShadow(device, PCAL6524_REG_PULL_EN_PORT_0 + port, active);
+}
+uint8_t PCAL6524_SetPolarity(
+    pcal6524_Device_t *device, pcal6524_Port_t port,
+    pcal6524_Pin_t pin, pcal6524_Polarity_t pol)
+{
+    if (port > 2 || pin > 7 || pol > 1)
+    { // Checks for input errors.
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    return PCAL6524_UpdateShadow(device, PCAL6524_REG_POL_PORT_0 + port, 1 << pin, pol << pin);
+}
+uint8_t PCAL6524_GetPolarityConfig(
+    pcal6524_Device_t *device, pcal6524_Port_t port,
+    uint8_t *pol)
+{
+    if (port > 2)
+    { // Checks for input errors.
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    return PCAL6524_GetShadow(device, PCAL6524_REG_POL_PORT_0 + port, pol);
+}
+uint8_t PCAL6524_SetInputLatch(
+    pcal6524_Device_t *device, pcal6524_Port_t port,
+    pcal6524_Pin_t pin, pcal6524_Latch_t latch)
+{
+    if (port > 2 || pin > 7 || latch > 1)
+    { // Checks for input errors.
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    return PCAL6524_UpdateShadow(device, PCAL6524_REG_IN_LATCH_PORT_0 + port, 1 << pin, latch << pin);
+}
+uint8_t PCAL6524_SetPortInputLatch(
+    pcal6524_Device_t *device, pcal6524_Port_t port,
+    uint8_t latches)
+{
+    if (port > 2)
+    { // Checks for input errors.
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    return PCAL6524_UpdateShadow(device, PCAL6524_REG_IN_LATCH_PORT_0 + port, 0xFF, latches);
+}
+uint8_t PCAL6524_GetInputLatchConfig(
+    pcal6524_Device_t *device, pcal6524_Port_t port,
+    uint8_t *latches)
+{
+    if (port > 2)
+    { // Checks for input errors.
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    return PCAL6524_GetShadow(device, PCAL6524_REG_IN_LATCH_PORT_0 + port, latches);
+}
+uint8_t PCAL6524_SetDebounce(
+    pcal6524_Device_t *device, pcal6524_Port_t port,
+    pcal6524_Pin_t pin, uint8_t enable)
+{
+    if (port > 1 || pin > 7 || enable > 1)
+    { // Checks for input errors.
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    return PCAL6524_UpdateShadow(device, PCAL6524_REG_DEBOUNCE_EN_PORT_0 + port, 1 << pin, enable << pin);
+}
+uint8_t PCAL6524_SetDebounceCount(pcal6524_Device_t *device, uint8_t count)
+{
+    return PCAL6524_UpdateShadow(device, PCAL6524_REG_DEBOUNCE_COUNT, 0xFF, count);
+}
+uint8_t PCAL6524_GetDebounceConfig(pcal6524_Device_t *device, uint16_t *pins, uint8_t *count)
+{
+    uint8_t data[2] = {0}; // Holds data for i2c communication.
+    uint8_t status = 0;    // Holds i2c status for error catching.
+    status = PCAL6524_GetShadow(device, PCAL6524_REG_DEBOUNCE_EN_PORT_0, &data[0]);
+    if (status == HAL_OK)
+    {
+        status = PCAL6524_GetShadow(device, PCAL6524_REG_DEBOUNCE_EN_PORT_1, &data[1]);
+    }
+    if (status == HAL_OK)
+    {
+        status = PCAL6524_GetShadow(device, PCAL6524_REG_DEBOUNCE_COUNT, count);
+    }
+    *pins = data[0] | (data[1] << 8);
+    return status;
+}
+uint8_t PCAL6524_ConfigureDebounce(pcal6524_Device_t *device, uint16_t pins, uint8_t count)
+{
+    uint8_t batch = device->batchActive; // Joins an open batch instead of committing.
+    uint8_t status = 0;                  // Holds i2c status for error catching.
+    const uint8_t changes[][3] = {
+        /* P0_0 becomes the debounce clock input. */
+        {PCAL6524_REG_CONF_PORT_0, 0x01, 0x01},
+        {PCAL6524_REG_PULL_EN_PORT_0, 0x01, 0x00},
+        {PCAL6524_REG_IN_LATCH_PORT_0, 0x01, 0x00},
+        {PCAL6524_REG_INT_MASK_PORT_0, 0x01, 0x01},
+        {PCAL6524_REG_DEBOUNCE_EN_PORT_0, 0xFF, (uint8_t)(pins & 0xFE)},
+        {PCAL6524_REG_DEBOUNCE_EN_PORT_1, 0xFF, (uint8_t)(pins >> 8)},
+        {PCAL6524_REG_DEBOUNCE_COUNT, 0xFF, count},
+    };
+    PCAL6524_BeginBatch(device);
+    for (uint8_t i = 0; i < sizeof(changes) / sizeof(changes[0]) && status == HAL_OK; i++)
+    {
+        status = PCAL6524_UpdateShadow(device, changes[i][0], changes[i][1], changes[i][2]);
+    }
+    if (!batch)
+    {
+        uint8_t commit = PCAL6524_CommitBatch(device); // Sends the changes recorded so far.
+        status = (status > HAL_OK) ? status : commit;
+    }
+    if (status == HAL_OK)
+    {
+        device->debounceMode = PCAL6524_DebounceHardware;
+    }
+    return status;
+}
+uint8_t PCAL6524_SetInterruptTrigger(
+    pcal6524_Device_t *device, pcal6524_Port_t port,
+    pcal6524_Pin_t pin, pcal6524_InterruptTrigger_t trig)
+{
+    /* Checks for input errors. */
+    if (port > 2 || pin > 7 || trig > 0b11)
+    {
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    /* Each port has two edge registers (A for pins 0-3, B for pins 4-7) with two bits per pin. */
+    return PCAL6524_UpdateShadow(device, PCAL6524_REG_INT_EGDE_PORT_0A + 2 * port + (pin / 4),
+                                 0b11 << (2 * (pin % 4)), trig << (2 * (pin % 4)));
+}
+uint8_t PCAL6524_GetInterruptTriggerConfig(
+    pcal6524_Device_t *device, pcal6524_Port_t port,
+    pcal6524_Pin_t pin, pcal6524_InterruptTrigger_t *trig)
+{
+    uint8_t data = 0;   // Holds data for i2c communication.
+    uint8_t status = 0; // Holds i2c status for error catching.
+    if (port > 2 || pin > 7)
+    { // Checks for input errors.
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    status = PCAL6524_GetShadow(device, PCAL6524_REG_INT_EGDE_PORT_0A + 2 * port + (pin / 4), &data);
+    if (status > HAL_OK)
+    {
+        return status;
+    }
+    *trig = (pcal6524_InterruptTrigger_t)((data >> (2 * (pin % 4))) & 0b11); // Picks out wanted pin trigger.
+    return PCAL6524_SUCCESS;
+}
+uint8_t PCAL6524_SetAllInterruptTriggers(pcal6524_Device_t *device, uint64_t edges)
+{
+    uint8_t mask[PCAL6524_EDGE_REGISTERS]; // Every bit of the edge registers is written.
+    uint8_t bits[PCAL6524_EDGE_REGISTERS]; // Edge map split into register bytes.
+    if (edges >> (2 * PCAL6524_PIN_COUNT))
+    { // Checks for input errors.
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    for (uint8_t i = 0; i < PCAL6524_EDGE_REGISTERS; i++)
+    { // Register order 0A, 0B, 1A ... matches the bit order of the map.
+        mask[i] = 0xFF;
+        bits[i] = (uint8_t)(edges >> (8 * i));
+    }
+    return PCAL6524_UpdateShadowRange(device, PCAL6524_REG_INT_EGDE_PORT_0A, PCAL6524_EDGE_REGISTERS, mask, bits);
+}
+uint8_t PCAL6524_SetInterruptTriggerArray(pcal6524_Device_t *device, const pcal6524_InterruptTrigger_t *trigs)
+{
+    uint64_t edges = 0; // Packed edge map.
+    for (uint8_t i = 0; i < PCAL6524_PIN_COUNT; i++)
+    {
+        if (trigs[i] > 0b11)
+        { // Checks for input errors.
+            return PCAL6524_INPUTOUTOFRANGE;
+        }
+        edges |= (uint64_t)trigs[i] << (2 * i);
+    }
+    return PCAL6524_SetAllInterruptTriggers(device, edges);
+}
+uint8_t PCAL6524_GetAllInterruptTriggers(pcal6524_Device_t *device, uint64_t *edges)
+{
+    uint8_t status = 0; // Holds i2c status for error catching.
+    status = PCAL6524_FetchShadowRange(device, PCAL6524_REG_INT_EGDE_PORT_0A, PCAL6524_EDGE_REGISTERS);
+    if (status > HAL_OK)
+    {
+        return status;
+    }
+    *edges = 0;
+    for (uint8_t i = 0; i < PCAL6524_EDGE_REGISTERS; i++)
+    {
+        *edges |= (uint64_t)device->shadow[PCAL6524_REG_INT_EGDE_PORT_0A + i] << (8 * i);
+    }
+    return PCAL6524_SUCCESS;
+}
+uint8_t PCAL6524_GetInterruptTriggerArray(pcal6524_Device_t *device, pcal6524_InterruptTrigger_t *trigs)
+{
+    uint64_t edges = 0; // Packed edge map.
+    uint8_t status = 0; // Holds i2c status for error catching.
+    status = PCAL6524_GetAllInterruptTriggers(device, &edges);
+    if (status > HAL_OK)
+    {
+        return status;
+    }
+    for (uint8_t i = 0; i < PCAL6524_PIN_COUNT; i++)
+    {
+        trigs[i] = (pcal6524_InterruptTrigger_t)((edges >> (2 * i)) & 0b11);
+    }
+    return PCAL6524_SUCCESS;
+}
+uint8_t PCAL6524_GetPinValue(
+    pcal6524_Device_t *device, pcal6524_Port_t port,
+    pcal6524_Pin_t pin, pcal6524_Value_t *value)
+{
+    uint8_t data = 0;   // Holds data for i2c communication.
+    uint8_t status = 0; // Holds i2c status for error catching.
+    if (port > 2 || pin > 7)
+    { // Checks for input errors.
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    /* Reads input values of selected port without resetting the interrupt. */
+    status = PCAL6524_ReadRegisters(device, PCAL6524_REG_IN_STATUS_PORT_0 + port, &data, 1);
+    if (status > HAL_OK)
+    {
+        return status;
+    }
+    *value = (pcal6524_Value_t)((data >> pin) & 1); // Picks out wanted pin value.
+    data = 1 << pin;
+    /* Resets interrupt on read pin. */
+    status = PCAL6524_WriteRegisters(device, PCAL6524_REG_INT_CLEAR_PORT_0 + port, &data, 1);
     if (status > HAL_OK)
     {
         return status;
     }
     return PCAL6524_SUCCESS; // Returns success code when transmission successful.
 }
-uint8_t PCAL6524_GetPullupDownConfig(
+uint8_t PCAL6524_OutputValue(
     pcal6524_Device_t *device, pcal6524_Port_t port,
-    uint8_t *pull, uint8_t *active)
+    pcal6524_Pin_t pin, pcal6524_Value_t value)
 {
-    uint8_t status = 0; // Holds i2c status for error catching.
-    if (port > 2)
+    /* Checks for input errors. */
+    if (port > 2 || pin > 7 || value > 1)
+    {
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    return PCAL6524_UpdateShadow(device, PCAL6524_REG_OUT_PORT_0 + port, 1 << pin, value << pin);
+}
+static uint8_t PCAL6524_MarkBit(pcal6524_Device_t *device, uint8_t reg, uint8_t pin, uint8_t value)
+{
+    if (!PCAL6524_RegBit(device->shadowValid, reg))
+    { // The commit would send unknown values for the other pins.
+        return HAL_ERROR;
+    }
+    /* Dirty first, so a completing write no longer copies its byte over the marked pin. */
+    PCAL6524_SetRegBit(device->shadowDirty, reg, 1);
+    PCAL6524_WriteBit(&device->shadow[reg], pin, value);
+    return PCAL6524_SUCCESS;
+}
+uint8_t PCAL6524_MarkOutput(pcal6524_Device_t *device, pcal6524_Port_t port, pcal6524_Pin_t pin, pcal6524_Value_t value)
+{
+    if (port > 2 || pin > 7 || value > 1)
+    { // Checks for input errors.
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    return PCAL6524_MarkBit(device, PCAL6524_REG_OUT_PORT_0 + port, pin, value);
+}
+uint8_t PCAL6524_MarkInOut(pcal6524_Device_t *device, pcal6524_Port_t port, pcal6524_Pin_t pin, pcal6524_InOut_t io)
+{
+    if (port > 2 || pin > 7 || io > 1)
     { // Checks for input errors.
         return PCAL6524_INPUTOUTOFRANGE;
     }
-    /* Repeats i2c call, in case of busy i2c unit.*/
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
+    return PCAL6524_MarkBit(device, PCAL6524_REG_CONF_PORT_0 + port, pin, io);
+}
+uint8_t PCAL6524_WriteOutputsMasked(pcal6524_Device_t *device, uint32_t setMask, uint32_t clearMask)
+{
+    uint8_t mask[3] = {0}; // Pins that get changed per port.
+    uint8_t bits[3] = {0}; // New values of changed pins per port.
+    /* Checks for input errors. */
+    if ((setMask | clearMask) > 0xFFFFFF)
     {
-        /* Reads current setting of pull-up/pull-down select register. */
-        switch (port)
-        {
-        case 0:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_PULL_SEL_PORT_0, pull);
-            break;
-        case 1:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_PULL_SEL_PORT_1, pull);
-            break;
-        case 2:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_PULL_SEL_PORT_2, pull);
-            break;
-        }
-        if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
-        }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
-            return HAL_ERROR;
-        }
-        else
-        {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
-        }
+        return PCAL6524_INPUTOUTOFRANGE;
     }
-    /* Catches case when all attempts failed and returns last error code. */
-    if (status > HAL_OK)
+    for (uint8_t port = 0; port < 3; port++)
     {
+        mask[port] = (uint8_t)((setMask | clearMask) >> (8 * port));
+        bits[port] = (uint8_t)(setMask >> (8 * port));
+    }
+    return PCAL6524_UpdateShadowRange(device, PCAL6524_REG_OUT_PORT_0, 3, mask, bits);
+}
+uint8_t PCAL6524_StreamOutputs(pcal6524_Device_t *device, pcal6524_Port_t port, const uint8_t *frames, uint16_t n)
+{
+    /* Without the auto-increment flag every data byte lands in the same output register. */
+    pcal6524_Request_t request = {device, PCAL6524_REG_OUT_PORT_0 + port, 0, (uint8_t *)frames, n, NULL, NULL, 0, 0, 0, 0};
+    uint8_t status = 0; // Holds i2c status for error catching.
+    if (port > 2 || n == 0 || frames == NULL)
+    { // Checks for input errors.
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    if (device->batchActive || PCAL6524_RegBit(device->shadowDirty, PCAL6524_REG_OUT_PORT_0 + port))
+    { // The pending value would be committed over the last frame.
+        return HAL_BUSY;
+    }
+    status = PCAL6524_Retry(&request);
+    if (status == PCAL6524_DEVICEOFFLINE)
+    { // Nothing was sent, the latch is unchanged.
         return status;
     }
-    /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
+    /* The blocking transports skip PCAL6524_CompleteTransfer, so the latch is tracked here for all of them. */
+    if (status == HAL_OK)
     {
-        /* Reads current setting of pull-up/pull-down enable register. */
-        switch (port)
-        {
-        case 0:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_PULL_EN_PORT_0, active);
-            break;
-        case 1:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_PULL_EN_PORT_1, active);
-            break;
-        case 2:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_PULL_EN_PORT_2, active);
-            break;
-        }
-        if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
-        }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
-            return HAL_ERROR;
-        }
-        else
-        {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
-        }
+        PCAL6524_StoreShadow(device, PCAL6524_REG_OUT_PORT_0 + port, frames[n - 1]);
     }
-    /* Catches case when all attempts failed and returns last error code. */
-    if (status > HAL_OK)
+    PCAL6524_SetRegBit(device->shadowValid, PCAL6524_REG_OUT_PORT_0 + port, status == HAL_OK);
+    return status;
+}
+uint8_t PCAL6524_ConfigureOutputs(pcal6524_Device_t *device, uint32_t mask, uint32_t values)
+{
+    uint8_t pins[3] = {0};  // Pins that become outputs per port.
+    uint8_t bits[3] = {0};  // Output values of these pins per port.
+    uint8_t zeros[3] = {0}; // Output direction (0) for the configuration registers.
+    uint8_t status = 0;     // Holds i2c status for error catching.
+    /* Checks for input errors. */
+    if (mask > 0xFFFFFF)
     {
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    for (uint8_t port = 0; port < 3; port++)
+    {
+        pins[port] = (uint8_t)(mask >> (8 * port));
+        bits[port] = (uint8_t)(values >> (8 * port));
+    }
+    /* The output latch is loaded before the drivers are enabled, so no pin drives a stale value.
+     * A batch commit keeps this order since it writes registers in ascending order. The five byte gap
+     * 0x07 - 0x0B exceeds PCAL6524_TRANSACTION_OVERHEAD, so two writes are cheaper than one burst. */
+    status = PCAL6524_UpdateShadowRange(device, PCAL6524_REG_OUT_PORT_0, 3, pins, bits);
+    if (status > HAL_OK)
+    { // Keeps the pins as inputs when their output value is not certain.
         return status;
     }
-    return PCAL6524_SUCCESS; // Returns success code when transmission successful.
+    return PCAL6524_UpdateShadowRange(device, PCAL6524_REG_CONF_PORT_0, 3, pins, zeros);
 }
-uint8_t PCAL6524_SetPolarity(
+uint8_t PCAL6524_GetPortPinValues(
     pcal6524_Device_t *device, pcal6524_Port_t port,
-    pcal6524_Pin_t pin, pcal6524_Polarity_t pol)
+    uint8_t *values)
 {
-    uint8_t data = 0;   // Holds data for i2c communication.
-    uint8_t status = 0; // Holds i2c status for error catching.
-    if (port > 2 || pin > 7 || pol > 1)
+    if (port > 2)
     { // Checks for input errors.
         return PCAL6524_INPUTOUTOFRANGE;
     }
-    /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
+    return PCAL6524_ReadRegisters(device, PCAL6524_REG_IN_PORT_0 + port, values, 1);
+}
+uint8_t PCAL6524_GetAllPinValues(pcal6524_Device_t *device, uint32_t *mask)
+{
+    uint8_t data[3] = {0}; // Holds data for i2c communication.
+    uint8_t status = 0;    // Holds i2c status for error catching.
+    /* Reads all input ports in one burst, so the values form a coherent snapshot. */
+    status = PCAL6524_ReadRegisters(device, PCAL6524_REG_IN_PORT_0, data, 3);
+    if (status > HAL_OK)
     {
-        switch (port)
-        { // Reads current setting of register.
-        case 0:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_POL_PORT_0, &data);
-            break;
-        case 1:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_POL_PORT_1, &data);
-            break;
-        case 2:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_POL_PORT_2, &data);
-            break;
-        }
-        if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
-        }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
-            return HAL_ERROR;
-        }
-        else
-        {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
-        }
+        return status;
     }
-    /* Catches case when all attempts failed and returns last error code. */
+    *mask = data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16);
+    return PCAL6524_SUCCESS; // Returns success code when transmission successful.
+}
+uint8_t PCAL6524_GetCachedInputs(pcal6524_Device_t *device, uint32_t maxAge, uint32_t *values)
+{
+    pcal6524_InputCache_t *cache = &device->inputCache;
+    uint8_t data[3] = {0}; // Holds data for i2c communication.
+    uint8_t status = 0;    // Holds i2c status for error catching.
+    if (maxAge > 0 && cache->valid && (HAL_GetTick() - cache->tick) <= maxAge / 1000U + 1U &&
+        (PCAL6524_Cycles() - cache->timestamp) <= PCAL6524_UsToCycles(maxAge))
+    { // Fresh enough, no bus access.
+        cache->hits++;
+        *values = cache->values;
+        return PCAL6524_SUCCESS;
+    }
+    cache->misses++;
+    /* Reads all ports in one burst; IN_STATUS leaves pending interrupts alone. */
+    status = PCAL6524_ReadRegisters(device, PCAL6524_REG_IN_STATUS_PORT_0, data, 3);
     if (status > HAL_OK)
     {
         return status;
     }
-    /* Combines current value of register with value that has to be changed. */
-    data = (data & (~(0b1 << pin))) | (pol << pin);
-    /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
-    {
-        switch (port)
-        { // Sends changed register settings to chip.
-        case 0:
-            status = PCAL6524_WriteI2C(device, PCAL6524_REG_POL_PORT_0, &data);
-            break;
-        case 1:
-            status = PCAL6524_WriteI2C(device, PCAL6524_REG_POL_PORT_1, &data);
-            break;
-        case 2:
-            status = PCAL6524_WriteI2C(device, PCAL6524_REG_POL_PORT_2, &data);
-            break;
-        }
-        if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
-        }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
-            return HAL_ERROR;
-        }
-        else
-        {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
-        }
+    cache->values = data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16);
+    cache->timestamp = PCAL6524_Cycles();
+    cache->tick = HAL_GetTick();
+    cache->valid = 1;
+    *values = cache->values;
+    return PCAL6524_SUCCESS;
+}
+uint8_t PCAL6524_GetCachedPinValue(
+    pcal6524_Device_t *device, pcal6524_Port_t port,
+    pcal6524_Pin_t pin, uint32_t maxAge, pcal6524_Value_t *value)
+{
+    uint32_t values = 0; // Input levels of all pins.
+    uint8_t status = 0;  // Holds i2c status for error catching.
+    if (port > 2 || pin > 7)
+    { // Checks for input errors.
+        return PCAL6524_INPUTOUTOFRANGE;
     }
-    /* Catches case when all attempts failed and returns last error code. */
+    status = PCAL6524_GetCachedInputs(device, maxAge, &values);
     if (status > HAL_OK)
     {
         return status;
     }
-    return PCAL6524_SUCCESS; // Returns success code when transmission successful.
+    *value = (pcal6524_Value_t)((values >> (8 * port + pin)) & 1); // Picks out wanted pin value.
+    return PCAL6524_SUCCESS;
 }
-uint8_t PCAL6524_GetPolarityConfig(
-    pcal6524_Device_t *device, pcal6524_Port_t port,
-    uint8_t *pol)
+uint8_t PCAL6524_CaptureInputs(pcal6524_Device_t *device, pcal6524_CaptureSource_t source, uint8_t port, uint8_t *samples, uint16_t n, uint32_t *period)
 {
+    pcal6524_Request_t request = {device, 0, 1, samples, n, NULL, NULL, 0, 0, 0, 0};
     uint8_t status = 0; // Holds i2c status for error catching.
-    if (port > 2)
+    uint32_t start = 0; // Cycle count at start of capture.
+    uint32_t cycles = 0;
+    if (source > PCAL6524_CaptureInputStatus || port > PCAL6524_CAPTURE_ALL_PORTS || n == 0 || samples == NULL)
     { // Checks for input errors.
         return PCAL6524_INPUTOUTOFRANGE;
     }
-    /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
-    {
-        switch (port)
-        { // Reads current setting of register.
-        case 0:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_POL_PORT_0, pol);
-            break;
-        case 1:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_POL_PORT_1, pol);
-            break;
-        case 2:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_POL_PORT_2, pol);
-            break;
-        }
-        if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
-        }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
-            return HAL_ERROR;
-        }
-        else
+    request.command = (source == PCAL6524_CaptureInputPort) ? PCAL6524_REG_IN_PORT_0 : PCAL6524_REG_IN_STATUS_PORT_0;
+    start = PCAL6524_Cycles();
+    if (port == PCAL6524_CAPTURE_ALL_PORTS)
+    { // Auto-increment runs on past port C, so each pass over the ports is a transaction of its own.
+        request.command |= PCAL6524_AUTO_INCREMENT;
+        for (uint16_t i = 0; i < n && status == HAL_OK; i += 3)
         {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
+            request.data = &samples[i];
+            request.len = (n - i < 3) ? n - i : 3;
+            status = PCAL6524_Retry(&request);
         }
     }
-    /* Catches case when all attempts failed and returns last error code. */
-    if (status > HAL_OK)
+    else
+    { // Reads the same register again for every data byte.
+        request.command += port;
+        status = PCAL6524_Retry(&request);
+    }
+    cycles = PCAL6524_Cycles() - start;
+    if (period != NULL)
     {
-        return status;
+        *period = (uint32_t)(((uint64_t)cycles * 1000000000U) / SystemCoreClock / n);
     }
-    return PCAL6524_SUCCESS; // Returns success code when transmission successful.
+    return status;
 }
-uint8_t PCAL6524_SetInterruptTrigger(
-    pcal6524_Device_t *device, pcal6524_Port_t port,
-    pcal6524_Pin_t pin, pcal6524_InterruptTrigger_t trig)
+uint8_t PCAL6524_InitPinGroup(pcal6524_PinGroup_t *group, const uint8_t *pins, uint8_t count)
 {
-    uint8_t data = 0;   // Holds data for i2c communication.
-    uint8_t status = 0; // Holds i2c status for error catching.
-    /* Checks for input errors. */
-    if (port > 2 || pin > 7 || trig > 0b11)
-    {
+    uint32_t used = 0; // Chip bits taken by the group.
+    uint8_t last = 0;  // Highest port holding a pin.
+    if (count == 0 || count > PCAL6524_PIN_COUNT)
+    { // Checks for input errors.
         return PCAL6524_INPUTOUTOFRANGE;
     }
-    /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
+    memset(group, 0, sizeof(*group));
+    group->firstPort = 2;
+    for (uint8_t i = 0; i < count; i++)
     {
-        switch (port)
-        { // Reads current setting of register.
-        case 0:
-            if (pin < 4)
-            {
-                status = PCAL6524_ReadI2C(device, PCAL6524_REG_INT_EGDE_PORT_0A, &data);
-            }
-            else
-            {
-                status = PCAL6524_ReadI2C(device, PCAL6524_REG_INT_EGDE_PORT_0B, &data);
-            }
-            break;
-        case 1:
-            if (pin < 4)
-            {
-                status = PCAL6524_ReadI2C(device, PCAL6524_REG_INT_EGDE_PORT_1A, &data);
-            }
-            else
-            {
-                status = PCAL6524_ReadI2C(device, PCAL6524_REG_INT_EGDE_PORT_1B, &data);
-            }
-            break;
-        case 2:
-            if (pin < 4)
-            {
-                status = PCAL6524_ReadI2C(device, PCAL6524_REG_INT_EGDE_PORT_2A, &data);
-            }
-            else
-            {
-                status = PCAL6524_ReadI2C(device, PCAL6524_REG_INT_EGDE_PORT_2B, &data);
-            }
-            break;
-        }
-        if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
-        }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
-            return HAL_ERROR;
+        if (pins[i] >= PCAL6524_PIN_COUNT || (used & (1UL << pins[i])))
+        { // Checks for input errors.
+            return PCAL6524_INPUTOUTOFRANGE;
+        }
+        used |= 1UL << pins[i];
+        group->portMask[pins[i] / 8] |= 1 << (pins[i] % 8);
+        group->firstPort = (pins[i] / 8 < group->firstPort) ? pins[i] / 8 : group->firstPort;
+        last = (pins[i] / 8 > last) ? pins[i] / 8 : last;
+        if (i > 0 && pins[i] == pins[i - 1] + 1)
+        { // Extends the run, the pin follows its predecessor on the chip as well.
+            group->runMask[group->runCount - 1] |= 1UL << pins[i];
         }
         else
         {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
+            group->runMask[group->runCount] = 1UL << pins[i];
+            group->runShift[group->runCount] = (int8_t)(pins[i] - i);
+            group->runCount++;
         }
     }
-    /* Catches case when all attempts failed and returns last error code. */
+    group->width = count;
+    group->portCount = last - group->firstPort + 1;
+    return PCAL6524_SUCCESS;
+}
+uint8_t PCAL6524_ReadPinGroup(pcal6524_Device_t *device, const pcal6524_PinGroup_t *group, uint32_t *value)
+{
+    uint8_t data[3] = {0}; // Holds data for i2c communication.
+    uint8_t status = 0;    // Holds i2c status for error catching.
+    uint32_t word = 0;     // Input levels in chip bit order.
+    status = PCAL6524_ReadRegisters(device, PCAL6524_REG_IN_PORT_0 + group->firstPort, data, group->portCount);
     if (status > HAL_OK)
     {
         return status;
     }
-    /* Combines current value of register with value that has to be changed. */
-    data = (data & (~(0b1 << (2 * (pin % 4))))) | (trig << (2 * (pin % 4)));
-    /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
+    for (uint8_t i = 0; i < group->portCount; i++)
     {
-        switch (port)
-        { // Sends changed register settings to chip.
-        case 0:
-            if (pin < 4)
-            {
-                status = PCAL6524_WriteI2C(device, PCAL6524_REG_INT_EGDE_PORT_0A, &data);
-            }
-            else
-            {
-                status = PCAL6524_WriteI2C(device, PCAL6524_REG_INT_EGDE_PORT_0B, &data);
-            }
-            break;
-        case 1:
-            if (pin < 4)
-            {
-                status = PCAL6524_WriteI2C(device, PCAL6524_REG_INT_EGDE_PORT_1A, &data);
-            }
-            else
-            {
-                status = PCAL6524_WriteI2C(device, PCAL6524_REG_INT_EGDE_PORT_1B, &data);
-            }
-            break;
-        case 2:
-            if (pin < 4)
-            {
-                status = PCAL6524_WriteI2C(device, PCAL6524_REG_INT_EGDE_PORT_2A, &data);
-            }
-            else
-            {
-                status = PCAL6524_WriteI2C(device, PCAL6524_REG_INT_EGDE_PORT_2B, &data);
-            }
-            break;
+        word |= (uint32_t)data[i] << (8 * (group->firstPort + i));
+    }
+    /* Gathers each run with a single shift. */
+    *value = 0;
+    for (uint8_t i = 0; i < group->runCount; i++)
+    {
+        if (group->runShift[i] >= 0)
+        {
+            *value |= (word & group->runMask[i]) >> group->runShift[i];
         }
-        if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
+        else
+        {
+            *value |= (word & group->runMask[i]) << -group->runShift[i];
         }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
-            return HAL_ERROR;
+    }
+    return PCAL6524_SUCCESS;
+}
+uint8_t PCAL6524_WritePinGroup(pcal6524_Device_t *device, const pcal6524_PinGroup_t *group, uint32_t value)
+{
+    uint8_t bits[3] = {0}; // New output values per port.
+    uint32_t word = 0;     // Output values in chip bit order.
+    /* Scatters each run with a single shift. */
+    for (uint8_t i = 0; i < group->runCount; i++)
+    {
+        if (group->runShift[i] >= 0)
+        {
+            word |= (value << group->runShift[i]) & group->runMask[i];
         }
         else
         {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
+            word |= (value >> -group->runShift[i]) & group->runMask[i];
         }
     }
-    /* Catches case when all attempts failed and returns last error code. */
-    if (status > HAL_OK)
+    for (uint8_t i = 0; i < group->portCount; i++)
     {
-        return status;
+        bits[i] = (uint8_t)(word >> (8 * (group->firstPort + i)));
     }
-    return PCAL6524_SUCCESS; // Returns success code when transmission successful.
+    return PCAL6524_UpdateShadowRange(device, PCAL6524_REG_OUT_PORT_0 + group->firstPort, group->portCount,
+                                      &group->portMask[group->firstPort], bits);
 }
-uint8_t PCAL6524_GetInterruptTriggerConfig(
+uint8_t PCAL6524_GetInterrupts(
     pcal6524_Device_t *device, pcal6524_Port_t port,
-    pcal6524_Pin_t pin, pcal6524_InterruptTrigger_t *trig)
+    uint8_t *intr)
 {
-    uint8_t status = 0; // Holds i2c status for error catching.
-    if (port > 2 || pin > 7)
+    if (port > 2)
     { // Checks for input errors.
         return PCAL6524_INPUTOUTOFRANGE;
     }
-    /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
+    return PCAL6524_ReadRegisters(device, PCAL6524_REG_INT_STAT_PORT_0 + port, intr, 1);
+}
+uint8_t PCAL6524_ClearAllInterrupts(pcal6524_Device_t *device)
+{
+    uint8_t data[3] = {0b11111111, 0b11111111, 0b11111111}; // Holds data for i2c communication.
+    /* Clears all three ports in one transaction. */
+    return PCAL6524_WriteRegisters(device, PCAL6524_REG_INT_CLEAR_PORT_0, data, 3);
+}
+
+uint8_t PCAL6524_ServiceInterrupt(pcal6524_Device_t *device, uint32_t *changed, uint32_t *state, uint32_t handleMask)
+{
+    uint8_t intStat[3];  // INT_STAT of all ports.
+    uint8_t inStatus[3]; // IN_STATUS of all ports.
+    uint8_t clear[3];    // Pins cleared per port.
+    uint8_t first = 3;   // First port to clear.
+    uint8_t last = 0;    // Last port to clear.
+    uint8_t status = 0;  // Holds i2c status for error catching.
+    /* Two short reads always beat one burst over 0x58-0x6E: 2 * (3 + PCAL6524_READ_OVERHEAD) bus bytes against 23 + PCAL6524_READ_OVERHEAD. */
+    status = PCAL6524_ReadRegisters(device, PCAL6524_REG_INT_STAT_PORT_0, intStat, 3);
+    if (status == HAL_OK)
     {
-        switch (port)
-        { // Reads current setting of register.
-        case 0:
-            if (pin < 4)
-            {
-                status = PCAL6524_ReadI2C(device, PCAL6524_REG_INT_EGDE_PORT_0A, trig);
-            }
-            else
-            {
-                status = PCAL6524_ReadI2C(device, PCAL6524_REG_INT_EGDE_PORT_0B, trig);
-            }
-            break;
-        case 1:
-            if (pin < 4)
-            {
-                status = PCAL6524_ReadI2C(device, PCAL6524_REG_INT_EGDE_PORT_1A, trig);
-            }
-            else
-            {
-                status = PCAL6524_ReadI2C(device, PCAL6524_REG_INT_EGDE_PORT_1B, trig);
-            }
-            break;
-        case 2:
-            if (pin < 4)
-            {
-                status = PCAL6524_ReadI2C(device, PCAL6524_REG_INT_EGDE_PORT_2A, trig);
-            }
-            else
+        status = PCAL6524_ReadRegisters(device, PCAL6524_REG_IN_STATUS_PORT_0, inStatus, 3);
+    }
+    if (status > HAL_OK)
+    {
+        return status;
+    }
+    *changed = intStat[0] | (intStat[1] << 8) | ((uint32_t)intStat[2] << 16);
+    *state = inStatus[0] | (inStatus[1] << 8) | ((uint32_t)inStatus[2] << 16);
+    for (uint8_t port = 0; port < 3; port++)
+    {
+        clear[port] = (*changed & handleMask) >> (8 * port);
+        if (clear[port] != 0)
+        {
+            if (first == 3)
             {
-                status = PCAL6524_ReadI2C(device, PCAL6524_REG_INT_EGDE_PORT_2B, trig);
+                first = port;
             }
-            break;
-        }
-        if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
-        }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
-            return HAL_ERROR;
-        }
-        else
-        {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
+            last = port;
         }
     }
-    /* Catches case when all attempts failed and returns last error code. */
+    if (first == 3)
+    { // Nothing handled, nothing to clear.
+        return PCAL6524_SUCCESS;
+    }
+    /* Clears the handled pins only, so unhandled ones keep INT asserted. */
+    return PCAL6524_WriteRegisters(device, PCAL6524_REG_INT_CLEAR_PORT_0 + first, &clear[first], last - first + 1);
+}
+
+uint8_t PCAL6524_GetLatchedInputs(pcal6524_Device_t *device, uint32_t *changed, uint32_t *levels)
+{
+    uint8_t data[3];    // Holds data for i2c communication.
+    uint8_t status = 0; // Holds i2c status for error catching.
+    /* Status first, reading the input port clears it. */
+    status = PCAL6524_ReadRegisters(device, PCAL6524_REG_INT_STAT_PORT_0, data, 3);
+    if (status > HAL_OK)
+    {
+        return status;
+    }
+    *changed = data[0] | (data[1] << 8) | ((uint32_t)data[2] << 16);
+    status = PCAL6524_ReadRegisters(device, PCAL6524_REG_IN_PORT_0, data, 3);
     if (status > HAL_OK)
     {
         return status;
     }
-    return PCAL6524_SUCCESS; // Returns success code when transmission successful.
+    *levels = data[0] | (data[1] << 8) | ((uint32_t)data[2] << 16);
+    return PCAL6524_SUCCESS;
 }
-uint8_t PCAL6524_GetPinValue(
-    pcal6524_Device_t *device, pcal6524_Port_t port,
-    pcal6524_Pin_t pin, pcal6524_Value_t *value)
+
+uint8_t PCAL6524_GetDebouncedInputs(pcal6524_Device_t *device, uint32_t pins, uint32_t *values)
 {
-    uint8_t data = 0;   // Holds data for i2c communication.
-    uint8_t status = 0; // Holds i2c status for error catching.
-    if (port > 2 || pin > 7)
-    { // Checks for input errors.
-        return PCAL6524_INPUTOUTOFRANGE;
+    uint8_t data[3] = {0};  // Holds data for i2c communication.
+    uint8_t status = 0;     // Holds i2c status for error catching.
+    uint32_t hardware = 0;  // Pins filtered by the chip.
+    uint32_t sample = 0;    // Levels of the current read.
+    uint32_t first = 0;     // Levels of the first read.
+    uint32_t unstable = 0;  // Pins that changed within the window.
+    if (device->debounceMode == PCAL6524_DebounceHardware)
+    {
+        hardware = (device->shadow[PCAL6524_REG_DEBOUNCE_EN_PORT_0] | (device->shadow[PCAL6524_REG_DEBOUNCE_EN_PORT_1] << 8)) & pins;
     }
-    /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
+    for (uint8_t i = 0; i < PCAL6524_DEBOUNCE_SAMPLES; i++)
     {
-        /* Reads input values of selected port without resetting the interrupt. */
-        switch (port)
+        if (i > 0)
         {
-        case 0:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_IN_STATUS_PORT_0, value);
-            break;
-        case 1:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_IN_STATUS_PORT_1, value);
-            break;
-        case 2:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_IN_STATUS_PORT_2, value);
-            break;
-        }
-        if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
+            PCAL6524_DelayUs(PCAL6524_DEBOUNCE_INTERVAL);
         }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
-            return HAL_ERROR;
+        /* IN_STATUS, so sampling does not clear interrupts or latches. */
+        status = PCAL6524_ReadRegisters(device, PCAL6524_REG_IN_STATUS_PORT_0, data, 3);
+        if (status > HAL_OK)
+        {
+            return status;
         }
-        else
+        sample = data[0] | (data[1] << 8) | ((uint32_t)data[2] << 16);
+        if (i == 0)
         {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
+            first = sample;
+            device->debounced = (device->debounced & ~hardware) | (sample & hardware);
+            if ((pins & ~hardware) == 0)
+            { // One read is enough when the chip filters every pin of interest.
+                break;
+            }
         }
+        unstable |= sample ^ first;
     }
-    /* Catches case when all attempts failed and returns last error code. */
-    if (status > HAL_OK)
+    /* Takes the new level of software filtered pins only if it held over the whole window. */
+    device->debounced = (device->debounced & (hardware | unstable | ~pins)) | (first & pins & ~hardware & ~unstable);
+    *values = device->debounced & pins;
+    return PCAL6524_SUCCESS;
+}
+
+static void PCAL6524_StartEventRead(pcal6524_Device_t *device);
+
+static void PCAL6524_FinishEvent(pcal6524_Device_t *device)
+{
+    pcal6524_EventPipe_t *pipe = &device->events;
+    uint8_t restart = 0; // Set if another edge has to be handled.
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    /* INT stays low while any pin is still reported, so no further edge would come. */
+    restart = pipe->pending || (pipe->intPort != NULL && HAL_GPIO_ReadPin(pipe->intPort, pipe->intPin) == GPIO_PIN_RESET);
+    pipe->pending = 0;
+    pipe->busy = restart;
+    __set_PRIMASK(primask);
+    if (restart)
     {
-        return status;
+        PCAL6524_StartEventRead(device);
     }
-    *value = (*value & (1 << pin)) >> pin; // Picks out wanted pin value.
-    data = 1 << pin;
-    /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
+}
+
+static void PCAL6524_EventClearCallback(pcal6524_Device_t *device, uint8_t status, void *context)
+{
+    PCAL6524_FinishEvent(device);
+}
+
+static void PCAL6524_EventStatCallback(pcal6524_Device_t *device, uint8_t status, void *context)
+{
+    pcal6524_EventPipe_t *pipe = &device->events;
+    pipe->failed = (status != HAL_OK);
+    pipe->statDone = 1;
+    if (pipe->orphan)
+    { // The input read was never queued, so this edge ends here.
+        pipe->orphan = 0;
+        pipe->busy = 0;
+    }
+}
+
+static void PCAL6524_EventReadCallback(pcal6524_Device_t *device, uint8_t status, void *context)
+{
+    pcal6524_EventPipe_t *pipe = &device->events;
+    uint8_t head = pipe->head;
+    if (status == HAL_OK && !pipe->failed)
     {
-        switch (port)
-        { // Resets interrupt on read pin.
-        case 0:
-            status = PCAL6524_WriteI2C(device, PCAL6524_REG_INT_CLEAR_PORT_0, &data);
-            break;
-        case 1:
-            status = PCAL6524_WriteI2C(device, PCAL6524_REG_INT_CLEAR_PORT_1, &data);
-            break;
-        case 2:
-            status = PCAL6524_WriteI2C(device, PCAL6524_REG_INT_CLEAR_PORT_2, &data);
-            break;
+        if ((uint8_t)(head - pipe->tail) < PCAL6524_EVENT_QUEUE_SIZE)
+        {
+            pipe->ring[head % PCAL6524_EVENT_QUEUE_SIZE].changed = pipe->intStat[0] | (pipe->intStat[1] << 8) | ((uint32_t)pipe->intStat[2] << 16);
+            pipe->ring[head % PCAL6524_EVENT_QUEUE_SIZE].state = pipe->inStatus[0] | (pipe->inStatus[1] << 8) | ((uint32_t)pipe->inStatus[2] << 16);
+            pipe->ring[head % PCAL6524_EVENT_QUEUE_SIZE].timestamp = pipe->timestamp;
+            __DMB(); // Publishes the slot before the index.
+            pipe->head = head + 1;
         }
-        if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
+        else
+        {
+            pipe->dropped++;
         }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
-            return HAL_ERROR;
+        /* Clears only the pins just reported, so later changes keep INT asserted. */
+        memcpy(pipe->intClear, pipe->intStat, sizeof(pipe->intClear));
+        if (PCAL6524_WriteAsync(device, PCAL6524_REG_INT_CLEAR_PORT_0, pipe->intClear, sizeof(pipe->intClear), PCAL6524_EventClearCallback, NULL) == HAL_OK)
+        {
+            return;
+        }
+    }
+    PCAL6524_FinishEvent(device);
+}
+
+static void PCAL6524_StartEventRead(pcal6524_Device_t *device)
+{
+    pcal6524_EventPipe_t *pipe = &device->events;
+    uint8_t inputReg = PCAL6524_REG_IN_STATUS_PORT_0; // Register giving the input levels.
+    uint32_t primask = 0;
+    pipe->timestamp = PCAL6524_Cycles();
+    pipe->failed = 0;
+    pipe->statDone = 0;
+    pipe->orphan = 0;
+    for (uint8_t port = 0; port < 3; port++)
+    {
+        if (device->shadow[PCAL6524_REG_IN_LATCH_PORT_0 + port] != 0)
+        { // Latched levels are only given and released by the input port.
+            inputReg = PCAL6524_REG_IN_PORT_0;
+        }
+    }
+    if (PCAL6524_ReadAsync(device, PCAL6524_REG_INT_STAT_PORT_0, pipe->intStat, sizeof(pipe->intStat), PCAL6524_EventStatCallback, NULL) > HAL_OK)
+    { // Gives up on this edge, the next one starts over.
+        pipe->failed = 1;
+        pipe->busy = 0;
+        return;
+    }
+    if (PCAL6524_ReadAsync(device, inputReg, pipe->inStatus, sizeof(pipe->inStatus), PCAL6524_EventReadCallback, NULL) > HAL_OK)
+    { // Gives up on this edge once the queued INT_STAT read no longer writes into the buffers.
+        primask = __get_PRIMASK();
+        __disable_irq();
+        pipe->failed = 1;
+        if (pipe->statDone)
+        {
+            pipe->busy = 0;
         }
         else
         {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
+            pipe->orphan = 1;
         }
+        __set_PRIMASK(primask);
     }
-    /* Catches case when all attempts failed and returns last error code. */
-    if (status > HAL_OK)
-    {
-        return status;
+}
+
+uint8_t PCAL6524_HandleInterrupt(pcal6524_Device_t *device)
+{
+    pcal6524_EventPipe_t *pipe = &device->events;
+    uint32_t primask = 0;
+    if (device->transport != PCAL6524_TransportDMA && device->transport != PCAL6524_TransportIT)
+    { // Blocking transfers would wait on HAL_GetTick, which does not advance inside the EXTI interrupt.
+        return PCAL6524_INPUTOUTOFRANGE;
     }
-    return PCAL6524_SUCCESS; // Returns success code when transmission successful.
+    primask = __get_PRIMASK();
+    __disable_irq();
+    if (pipe->busy)
+    { // Handled when the running transfers finish.
+        pipe->pending = 1;
+        __set_PRIMASK(primask);
+        return PCAL6524_SUCCESS;
+    }
+    pipe->busy = 1;
+    __set_PRIMASK(primask);
+    PCAL6524_StartEventRead(device);
+    return PCAL6524_SUCCESS;
 }
-uint8_t PCAL6524_OutputValue(
-    pcal6524_Device_t *device, pcal6524_Port_t port,
-    pcal6524_Pin_t pin, pcal6524_Value_t value)
+
+uint8_t PCAL6524_PopEvent(pcal6524_Device_t *device, pcal6524_Event_t *event)
 {
-    uint8_t data = 0;   // Holds data for i2c communication.
-    uint8_t status = 0; // Holds i2c status for error catching.
-    /* Checks for input errors. */
-    if (port > 2 || pin > 7 || value > 1)
+    pcal6524_EventPipe_t *pipe = &device->events;
+    uint8_t tail = pipe->tail;
+    if (tail == pipe->head)
     {
-        return PCAL6524_INPUTOUTOFRANGE;
+        return 0;
     }
-    /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
+    __DMB(); // Reads the slot after the index that published it.
+    *event = pipe->ring[tail % PCAL6524_EVENT_QUEUE_SIZE];
+    __DMB();
+    pipe->tail = tail + 1;
+    return 1;
+}
+
+static void PCAL6524_BankUpdate(pcal6524_Bank_t *bank, int8_t pending, uint8_t status)
+{ // Shared with the I2C interrupts, which finish the device transfers.
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    bank->pending += pending;
+    if (status > HAL_OK && bank->status == HAL_OK)
+    { // Keeps the first error.
+        bank->status = status;
+    }
+    __set_PRIMASK(primask);
+}
+
+static void PCAL6524_BankCallback(pcal6524_Device_t *device, uint8_t status, void *context)
+{
+    pcal6524_Bank_t *bank = (pcal6524_Bank_t *)context;
+    for (uint8_t i = 0; i < PCAL6524_BANK_SIZE; i++)
     {
-        switch (port)
-        { // Reads current setting of register.
-        case 0:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_OUT_PORT_0, &data);
-            break;
-        case 1:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_OUT_PORT_1, &data);
-            break;
-        case 2:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_OUT_PORT_2, &data);
-            break;
-        }
-        if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
-        }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
-            return HAL_ERROR;
-        }
-        else
+        if (bank->devices[i] == device)
         {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
+            bank->done[i] = PCAL6524_Cycles();
         }
     }
-    /* Catches case when all attempts failed and returns last error code. */
-    if (status > HAL_OK)
+    PCAL6524_BankUpdate(bank, -1, status);
+}
+
+static uint8_t PCAL6524_BankWait(pcal6524_Bank_t *bank, uint8_t started)
+{
+    uint32_t tickstart = HAL_GetTick();
+    uint32_t first = 0; // Completion of the earliest device transfer.
+    uint32_t last = 0;  // Completion of the latest device transfer.
+    uint8_t seen = 0;   // Set once first and last hold a completion.
+    while (bank->pending > 0)
     {
-        return status;
+        PCAL6524_ServiceRetries();
+        if ((HAL_GetTick() - tickstart) > PCAL6524_I2C_TIMEOUT)
+        {
+            PCAL6524_AbortActive();
+            tickstart = HAL_GetTick();
+        }
     }
-    /* Combines current value of register with value that has to be changed. */
-    data = (data & (~(0b1 << pin))) | (value << pin);
-    /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
+    /* Skew between the devices, measured relative to the first completion so cycle counter wrap-around cancels out. */
+    for (uint8_t i = 0; i < PCAL6524_BANK_SIZE; i++)
     {
-        switch (port)
-        { // Sends changed register settings to chip.
-        case 0:
-            status = PCAL6524_WriteI2C(device, PCAL6524_REG_OUT_PORT_0, &data);
-            break;
-        case 1:
-            status = PCAL6524_WriteI2C(device, PCAL6524_REG_OUT_PORT_1, &data);
-            break;
-        case 2:
-            status = PCAL6524_WriteI2C(device, PCAL6524_REG_OUT_PORT_2, &data);
-            break;
-        }
-        if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
-        }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
-            return HAL_ERROR;
-        }
-        else
+        if (started & (1 << i))
         {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
+            if (!seen || (int32_t)(bank->done[i] - first) < 0)
+            {
+                first = bank->done[i];
+            }
+            if (!seen || (int32_t)(bank->done[i] - last) > 0)
+            {
+                last = bank->done[i];
+            }
+            seen = 1;
         }
     }
-    /* Catches case when all attempts failed and returns last error code. */
-    if (status > HAL_OK)
+    bank->skew = (uint32_t)(((uint64_t)(last - first) * 1000000000U) / SystemCoreClock);
+    return bank->status;
+}
+
+static pcal6524_Device_t *PCAL6524_BankPin(pcal6524_Bank_t *bank, uint8_t index, pcal6524_Port_t *port, pcal6524_Pin_t *pin)
+{
+    if (index >= PCAL6524_BANK_SIZE * PCAL6524_PIN_COUNT)
     {
-        return status;
+        return NULL;
     }
-    return PCAL6524_SUCCESS; // Returns success code when transmission successful.
+    *port = (pcal6524_Port_t)((index % PCAL6524_PIN_COUNT) / 8);
+    *pin = (pcal6524_Pin_t)(index % 8);
+    return bank->devices[index / PCAL6524_PIN_COUNT];
 }
-uint8_t PCAL6524_GetPortPinValues(
-    pcal6524_Device_t *device, pcal6524_Port_t port,
-    uint8_t *values)
+
+uint8_t PCAL6524_BankInit(pcal6524_Bank_t *bank)
 {
-    uint8_t status = 0; // Holds i2c status for error catching.
-    if (port > 2)
-    { // Checks for input errors.
-        return PCAL6524_INPUTOUTOFRANGE;
-    }
-    /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
+    uint8_t status = 0; // First error of the devices.
+    bank->pending = 0;
+    bank->status = HAL_OK;
+    bank->skew = 0;
+    for (uint8_t i = 0; i < PCAL6524_BANK_SIZE; i++)
     {
-        /* Reads input values of selected port without resetting the interrupt. */
-        switch (port)
+        for (uint8_t j = 0; j < i && bank->devices[i] != NULL; j++)
         {
-        case 0:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_IN_PORT_0, values);
-            break;
-        case 1:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_IN_PORT_1, values);
-            break;
-        case 2:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_IN_PORT_2, values);
-            break;
-        }
-        if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
+            if (bank->devices[j] != NULL && bank->devices[j]->hi2c == bank->devices[i]->hi2c && bank->devices[j]->a0 == bank->devices[i]->a0)
+            { // Checks for input errors: two devices on one address.
+                return PCAL6524_INPUTOUTOFRANGE;
+            }
         }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
-            return HAL_ERROR;
+    }
+    for (uint8_t i = 0; i < PCAL6524_BANK_SIZE; i++)
+    {
+        if (bank->devices[i] != NULL)
+        { // Keeps initializing the others, a missing device must not hold back the bank.
+            uint8_t result = PCAL6524_Init(bank->devices[i]);
+            status = (status > HAL_OK) ? status : result;
         }
-        else
+    }
+    return status;
+}
+
+void PCAL6524_BankBeginBatch(pcal6524_Bank_t *bank)
+{
+    for (uint8_t i = 0; i < PCAL6524_BANK_SIZE; i++)
+    {
+        if (bank->devices[i] != NULL)
         {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
+            PCAL6524_BeginBatch(bank->devices[i]);
         }
     }
-    /* Catches case when all attempts failed and returns last error code. */
-    if (status > HAL_OK)
+}
+
+uint8_t PCAL6524_BankCommitBatch(pcal6524_Bank_t *bank)
+{
+    uint8_t status = 0; // First error of the devices.
+    for (uint8_t i = 0; i < PCAL6524_BANK_SIZE; i++)
     {
-        return status;
+        if (bank->devices[i] != NULL)
+        {
+            uint8_t result = PCAL6524_CommitBatch(bank->devices[i]);
+            status = (status > HAL_OK) ? status : result;
+        }
     }
-    return PCAL6524_SUCCESS; // Returns success code when transmission successful.
+    return status;
 }
-uint8_t PCAL6524_GetInterrupts(
-    pcal6524_Device_t *device, pcal6524_Port_t port,
-    uint8_t *intr)
+
+uint8_t PCAL6524_BankSetInOut(pcal6524_Bank_t *bank, uint8_t index, pcal6524_InOut_t io)
+{
+    pcal6524_Port_t port;
+    pcal6524_Pin_t pin;
+    pcal6524_Device_t *device = PCAL6524_BankPin(bank, index, &port, &pin);
+    if (device == NULL)
+    { // Checks for input errors.
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    return PCAL6524_SetInOut(device, port, pin, io);
+}
+
+uint8_t PCAL6524_BankOutputValue(pcal6524_Bank_t *bank, uint8_t index, pcal6524_Value_t value)
+{
+    pcal6524_Port_t port;
+    pcal6524_Pin_t pin;
+    pcal6524_Device_t *device = PCAL6524_BankPin(bank, index, &port, &pin);
+    if (device == NULL)
+    { // Checks for input errors.
+        return PCAL6524_INPUTOUTOFRANGE;
+    }
+    return PCAL6524_OutputValue(device, port, pin, value);
+}
+
+uint8_t PCAL6524_BankGetPinValue(pcal6524_Bank_t *bank, uint8_t index, pcal6524_Value_t *value)
 {
+    pcal6524_Port_t port;
+    pcal6524_Pin_t pin;
+    pcal6524_Device_t *device = PCAL6524_BankPin(bank, index, &port, &pin);
+    uint8_t data = 0;   // Holds data for i2c communication.
     uint8_t status = 0; // Holds i2c status for error catching.
-    if (port > 2)
+    if (device == NULL)
     { // Checks for input errors.
         return PCAL6524_INPUTOUTOFRANGE;
     }
-    /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
+    /* IN_STATUS leaves interrupts pending, the event pipe may still have to report them. */
+    status = PCAL6524_ReadRegisters(device, PCAL6524_REG_IN_STATUS_PORT_0 + port, &data, 1);
+    if (status > HAL_OK)
+    {
+        return status;
+    }
+    *value = (pcal6524_Value_t)((data >> pin) & 1);
+    return PCAL6524_SUCCESS;
+}
+
+uint8_t PCAL6524_BankReadInputs(pcal6524_Bank_t *bank, uint32_t *values)
+{
+    uint8_t started = 0; // One bit per device with a queued read.
+    uint8_t status = 0;  // Holds i2c status for error catching.
+    bank->status = HAL_OK;
+    bank->pending = 0;
+    /* Queues all reads before the first one completes, so they run back to back from the I2C interrupts. */
+    for (uint8_t i = 0; i < PCAL6524_BANK_SIZE; i++)
     {
-        /* Reads input values of selected port without resetting the interrupt. */
-        switch (port)
+        values[i] = 0;
+        if (bank->devices[i] == NULL)
         {
-        case 0:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_INT_STAT_PORT_0, intr);
-            break;
-        case 1:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_INT_STAT_PORT_1, intr);
-            break;
-        case 2:
-            status = PCAL6524_ReadI2C(device, PCAL6524_REG_INT_STAT_PORT_2, intr);
-            break;
-        }
-        if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
-        }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
-            return HAL_ERROR;
+            continue;
         }
-        else
+        PCAL6524_BankUpdate(bank, 1, HAL_OK);
+        /* IN_STATUS instead of IN_PORT, which would clear interrupts pending on the chip. */
+        status = PCAL6524_ReadAsync(bank->devices[i], PCAL6524_REG_IN_STATUS_PORT_0, bank->data[i], 3, PCAL6524_BankCallback, bank);
+        if (status > HAL_OK)
         {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
+            PCAL6524_BankUpdate(bank, -1, status);
+            continue;
         }
+        started |= 1 << i;
     }
-    /* Catches case when all attempts failed and returns last error code. */
-    if (status > HAL_OK)
+    status = PCAL6524_BankWait(bank, started);
+    for (uint8_t i = 0; i < PCAL6524_BANK_SIZE; i++)
     {
-        return status;
+        if (started & (1 << i))
+        {
+            values[i] = bank->data[i][0] | ((uint32_t)bank->data[i][1] << 8) | ((uint32_t)bank->data[i][2] << 16);
+        }
     }
-    return PCAL6524_SUCCESS; // Returns success code when transmission successful.
+    return status;
 }
-uint8_t PCAL6524_ClearAllInterrupts(pcal6524_Device_t *device)
+
+uint8_t PCAL6524_BankWriteOutputs(pcal6524_Bank_t *bank, const uint32_t *values, const uint32_t *masks)
 {
-    uint8_t data = 0b11111111; // Holds data for i2c communication.
-    uint8_t status = 0;        // Holds i2c status for error catching.
-    /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
+    uint8_t first[PCAL6524_BANK_SIZE]; // First output register that changes per device.
+    uint8_t count[PCAL6524_BANK_SIZE]; // Registers from first up to the last one that changes.
+    uint8_t started = 0;               // One bit per device with a queued write.
+    uint8_t status = 0;                // Holds i2c status for error catching.
+    bank->status = HAL_OK;
+    bank->pending = 0;
+    /* Prepares every device first, so the transfers can follow each other without gaps. */
+    for (uint8_t i = 0; i < PCAL6524_BANK_SIZE; i++)
     {
-        status = PCAL6524_WriteI2C(device, PCAL6524_REG_INT_CLEAR_PORT_0, &data);
-        if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
+        pcal6524_Device_t *device = bank->devices[i];
+        count[i] = 0;
+        if (device == NULL || (masks[i] & 0xFFFFFF) == 0)
+        {
+            continue;
         }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
-            return HAL_ERROR;
+        if (device->batchActive)
+        { // Recorded with the batch of the device.
+            uint8_t mask[3] = {(uint8_t)masks[i], (uint8_t)(masks[i] >> 8), (uint8_t)(masks[i] >> 16)};
+            uint8_t bits[3] = {(uint8_t)values[i], (uint8_t)(values[i] >> 8), (uint8_t)(values[i] >> 16)};
+            PCAL6524_BankUpdate(bank, 0, PCAL6524_UpdateShadowRange(device, PCAL6524_REG_OUT_PORT_0, 3, mask, bits));
+            continue;
         }
-        else
+        status = PCAL6524_FetchShadowRange(device, PCAL6524_REG_OUT_PORT_0, 3);
+        if (status > HAL_OK)
+        {
+            PCAL6524_BankUpdate(bank, 0, status);
+            continue;
+        }
+        first[i] = 3;
+        for (uint8_t port = 0; port < 3; port++)
         {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
+            uint8_t mask = (uint8_t)(masks[i] >> (8 * port));
+            bank->data[i][port] = (device->shadow[PCAL6524_REG_OUT_PORT_0 + port] & ~mask) | ((uint8_t)(values[i] >> (8 * port)) & mask);
+            if (bank->data[i][port] != device->shadow[PCAL6524_REG_OUT_PORT_0 + port])
+            {
+                first[i] = (first[i] == 3) ? port : first[i];
+                count[i] = port - first[i] + 1;
+            }
         }
     }
-    /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
+    for (uint8_t i = 0; i < PCAL6524_BANK_SIZE; i++)
     {
-        status = PCAL6524_WriteI2C(device, PCAL6524_REG_INT_CLEAR_PORT_1, &data);
-        if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
+        if (count[i] == 0)
+        { // Device unused or already holding the values.
+            continue;
         }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
-            return HAL_ERROR;
-        }
-        else
+        PCAL6524_BankUpdate(bank, 1, HAL_OK);
+        status = PCAL6524_WriteAsync(bank->devices[i], PCAL6524_REG_OUT_PORT_0 + first[i], &bank->data[i][first[i]], count[i], PCAL6524_BankCallback, bank);
+        if (status > HAL_OK)
         {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
+            PCAL6524_BankUpdate(bank, -1, status);
+            continue;
         }
+        started |= 1 << i;
     }
-    /* Repeats i2c call, in case of busy i2c unit. */
-    for (uint8_t attempt = 0; attempt <= PCAL6524_I2C_MAX_ATTEMPTS; attempt++)
+    return PCAL6524_BankWait(bank, started);
+}
+
+#if defined(STM32F1)
+/**
+ * @brief Runs one driver call and stores the core cycles it took.
+ */
+#define PCAL6524_MEASURE(field, call)                  \
+    do                                                 \
+    {                                                  \
+        uint32_t start = DWT->CYCCNT;                  \
+        status |= (call);                              \
+        cycles->field = DWT->CYCCNT - start;           \
+    } while (0)
+
+static uint8_t PCAL6524_MeasureCalls(pcal6524_Device_t *device, pcal6524_CallCycles_t *cycles)
+{
+    uint8_t status = 0;  // Holds i2c status for error catching.
+    uint8_t data[3];     // Register values read and written back unchanged.
+    uint32_t mask = 0;   // Pin values.
+    pcal6524_Value_t value = PCAL6524_LOW;
+    memcpy(data, &device->shadow[PCAL6524_REG_OUT_PORT_0], sizeof(data));
+    PCAL6524_MEASURE(readRegister, PCAL6524_ReadI2C(device, PCAL6524_REG_IN_PORT_0, data, 1));
+    PCAL6524_MEASURE(readPair, PCAL6524_ReadI2C(device, PCAL6524_REG_IN_STATUS_PORT_0 | PCAL6524_AUTO_INCREMENT, data, 2));
+    memcpy(data, &device->shadow[PCAL6524_REG_OUT_PORT_0], sizeof(data));
+    PCAL6524_MEASURE(writeRegister, PCAL6524_WriteI2C(device, PCAL6524_REG_OUT_PORT_0, data, 1));
+    PCAL6524_MEASURE(writeOutputs, PCAL6524_WriteI2C(device, PCAL6524_REG_OUT_PORT_0 | PCAL6524_AUTO_INCREMENT, data, 3));
+    PCAL6524_MEASURE(getAllPinValues, PCAL6524_GetAllPinValues(device, &mask));
+    PCAL6524_MEASURE(getPinValue, PCAL6524_GetPinValue(device, PCAL6524_Port_A, PCAL6524_Pin_0, &value));
+    PCAL6524_MEASURE(getInterrupts, PCAL6524_GetInterrupts(device, PCAL6524_Port_A, data));
+    PCAL6524_MEASURE(clearAllInterrupts, PCAL6524_ClearAllInterrupts(device));
+    PCAL6524_MEASURE(refreshShadow, PCAL6524_RefreshShadow(device));
+    return status;
+}
+
+uint8_t PCAL6524_BenchmarkTransport(pcal6524_Device_t *device, pcal6524_TransportBenchmark_t *result)
+{
+    pcal6524_Transport_t transport = device->transport; // Restored afterwards.
+    uint8_t status = 0; // Holds i2c status for error catching.
+    PCAL6524_StartCycleCounter();
+    device->transport = PCAL6524_TransportBlocking;
+    status |= PCAL6524_MeasureCalls(device, &result->hal);
+    device->transport = PCAL6524_TransportLL;
+    status |= PCAL6524_MeasureCalls(device, &result->ll);
+    device->transport = transport;
+    return status;
+}
+
+uint8_t PCAL6524_BenchmarkBusSpeed(pcal6524_Device_t *device, pcal6524_SpeedBenchmark_t *result, uint8_t count)
+{
+    I2C_InitTypeDef init = device->hi2c->Init;  // Restored afterwards.
+    pcal6524_BusSpeed_t speed = device->busSpeed; // Restored afterwards.
+    uint8_t status = 0;                         // Holds i2c status for error catching.
+    uint8_t data[3];                            // Output registers written back unchanged.
+    uint32_t mask = 0;                          // Pin values.
+    uint32_t start = 0;                         // Cycle count at start of measurement.
+    PCAL6524_StartCycleCounter();
+    memcpy(data, &device->shadow[PCAL6524_REG_OUT_PORT_0], sizeof(data));
+    for (uint8_t i = 0; i < count && i < PCAL6524_BUS_SPEED_COUNT; i++)
     {
-        status = PCAL6524_WriteI2C(device, PCAL6524_REG_INT_CLEAR_PORT_2, &data);
-        if (status == HAL_OK)
-        { // Breaks out of loop when successful.
-            break;
-        }
-        else if (status == HAL_ERROR)
-        { // Returns error when i2c unit fails.
-            return HAL_ERROR;
+        status |= PCAL6524_SetBusSpeed(device, i);
+        result[i].clockSpeed = device->busSpeed.clockSpeed;
+        start = DWT->CYCCNT;
+        for (uint8_t round = 0; round < PCAL6524_BENCHMARK_ROUNDS; round++)
+        {
+            status |= PCAL6524_GetAllPinValues(device, &mask);
         }
-        else
+        result[i].readCycles = (DWT->CYCCNT - start) / PCAL6524_BENCHMARK_ROUNDS;
+        start = DWT->CYCCNT;
+        for (uint8_t round = 0; round < PCAL6524_BENCHMARK_ROUNDS; round++)
         {
-            /* Delays next i2c call if first attempt failed. */
-            HAL_Delay(PCAL6524_I2C_ATTEMPT_DELAY);
+            status |= PCAL6524_WriteI2C(device, PCAL6524_REG_OUT_PORT_0 | PCAL6524_AUTO_INCREMENT, data, sizeof(data));
         }
+        result[i].writeCycles = (DWT->CYCCNT - start) / PCAL6524_BENCHMARK_ROUNDS;
+    }
+    PCAL6524_WaitBusIdle();
+    device->hi2c->Init = init;
+    status |= HAL_I2C_Init(device->hi2c);
+    device->busSpeed = speed;
+    return status;
+}
+
+static void PCAL6524_MarkCritical(pcal6524_Device_t *device, uint8_t reg, uint8_t pin, uint8_t value)
+{ // Masked read-modify-write of the image guarded by disabling interrupts, for comparison.
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    device->shadow[reg] = (device->shadow[reg] & ~(1 << pin)) | (value << pin);
+    device->shadowDirty[reg >> 5] |= 1UL << (reg & 31);
+    __set_PRIMASK(primask);
+}
+
+uint8_t PCAL6524_BenchmarkBitBand(pcal6524_Device_t *device, pcal6524_BitBandBenchmark_t *result)
+{
+    uint32_t dirty[sizeof(device->shadowDirty) / sizeof(device->shadowDirty[0])]; // Restored afterwards.
+    uint8_t reg = PCAL6524_REG_OUT_PORT_0;
+    uint8_t value = 0;   // Pin 0 keeps its value, only the marks are timed.
+    uint32_t start = 0;  // Cycle count at start of measurement.
+    if (!PCAL6524_RegBit(device->shadowValid, reg))
+    {
+        return HAL_ERROR;
+    }
+    memcpy(dirty, device->shadowDirty, sizeof(dirty));
+    value = device->shadow[reg] & 0x01;
+    PCAL6524_StartCycleCounter();
+    start = DWT->CYCCNT;
+    for (uint8_t round = 0; round < PCAL6524_BENCHMARK_ROUNDS; round++)
+    {
+        PCAL6524_MarkBit(device, reg, 0, value);
+    }
+    result->bitBandCycles = (DWT->CYCCNT - start) / PCAL6524_BENCHMARK_ROUNDS;
+    start = DWT->CYCCNT;
+    for (uint8_t round = 0; round < PCAL6524_BENCHMARK_ROUNDS; round++)
+    {
+        PCAL6524_MarkCritical(device, reg, 0, value);
+    }
+    result->criticalCycles = (DWT->CYCCNT - start) / PCAL6524_BENCHMARK_ROUNDS;
+    memcpy(device->shadowDirty, dirty, sizeof(dirty));
+    return PCAL6524_SUCCESS;
+}
+
+uint8_t PCAL6524_BenchmarkStream(pcal6524_Device_t *device, pcal6524_Port_t port, pcal6524_StreamBenchmark_t *result)
+{
+    uint8_t frames[PCAL6524_STREAM_FRAMES]; // Pattern toggling pin 0.
+    uint8_t value = 0;                      // Output register before the measurement.
+    uint8_t status = 0;                     // Holds i2c status for error catching.
+    uint32_t start = 0;                     // Cycle count at start of measurement.
+    if (port > 2)
+    { // Checks for input errors.
+        return PCAL6524_INPUTOUTOFRANGE;
     }
-    /* Catches case when all attempts failed and returns last error code. */
+    status = PCAL6524_GetShadow(device, PCAL6524_REG_OUT_PORT_0 + port, &value);
     if (status > HAL_OK)
     {
         return status;
     }
-    return PCAL6524_SUCCESS; // Returns success code when transmission successful.
+    for (uint8_t i = 0; i < PCAL6524_STREAM_FRAMES; i++)
+    { // Even count, so the last frame restores the previous value.
+        frames[i] = value ^ ((i % 2) ? 0x00 : 0x01);
+    }
+    PCAL6524_StartCycleCounter();
+    start = DWT->CYCCNT;
+    for (uint8_t i = 0; i < PCAL6524_STREAM_FRAMES; i++)
+    {
+        status |= PCAL6524_OutputValue(device, port, PCAL6524_Pin_0, (pcal6524_Value_t)(frames[i] & 0x01));
+    }
+    result->outputValueCycles = (DWT->CYCCNT - start) / PCAL6524_STREAM_FRAMES;
+    start = DWT->CYCCNT;
+    status |= PCAL6524_StreamOutputs(device, port, frames, PCAL6524_STREAM_FRAMES);
+    result->streamCycles = (DWT->CYCCNT - start) / PCAL6524_STREAM_FRAMES;
+    result->outputValueRate = result->outputValueCycles ? SystemCoreClock / result->outputValueCycles : 0;
+    result->streamRate = result->streamCycles ? SystemCoreClock / result->streamCycles : 0;
+    return status;
 }
+#endif
 
 /**
  * @}
@@ -70,11 +70,27 @@ extern "C"
 
 #define PCAL6524_I2C_TIMEOUT (100)      ///< Time before I2C timeout [ms].
 #define PCAL6524_I2C_MAX_ATTEMPTS (3)   ///< Number of attempts, before error.
-#define PCAL6524_I2C_ATTEMPT_DELAY (10) ///< Time between attempts [ms].
+#define PCAL6524_I2C_ATTEMPT_DELAY (500) ///< Default wait before the first repeated attempt [us].
+#define PCAL6524_I2C_MAX_DELAY (8000)    ///< Default upper limit of the wait between attempts [us].
+#define PCAL6524_I2C_DEADLINE (20000)    ///< Default time after which a failing transfer is not repeated [us].
+#define PCAL6524_BREAKER_THRESHOLD (5)   ///< Consecutive failed transfers that take the device out of service.
+#define PCAL6524_BREAKER_COOLDOWN (200)  ///< Time between probes of a device out of service [ms].
+#define PCAL6524_RESET_CHECK_INTERVAL (100) ///< Time between power-on reset checks [ms].
+#define PCAL6524_LINK_CHECK_READS (8)    ///< Verification reads per bus speed during negotiation.
+#define PCAL6524_BUS_ERROR_LIMIT (3)     ///< Failed transfers per PCAL6524_BREAKER_COOLDOWN window that lower the bus speed.
+#define PCAL6524_BENCHMARK_ROUNDS (16)   ///< Repetitions averaged by the bus speed benchmark.
+#define PCAL6524_STREAM_FRAMES (64)      ///< Frames streamed by the output stream benchmark.
+#define PCAL6524_DEBOUNCE_SAMPLES (5)    ///< Reads of a software debounce window.
+#define PCAL6524_DEBOUNCE_INTERVAL (1000) ///< Time between reads of a software debounce window [us].
+#define PCAL6524_QUEUE_SIZE (8)         ///< Asynchronous transfers that can wait for the bus.
+#define PCAL6524_RETAINED_DEVICES (4)   ///< Shadow images kept in retained RAM across MCU resets.
+#define PCAL6524_BANK_SIZE (4)          ///< Devices of a bank, one per address pin setting.
+#define PCAL6524_EVENT_QUEUE_SIZE (16)  ///< Input events buffered between INT handling and application, power of two.
 
 // Error codes
 #define PCAL6524_SUCCESS (0)         ///< Error code for success.
 #define PCAL6524_INPUTOUTOFRANGE (3) ///< Error code for wrong input.
+#define PCAL6524_DEVICEOFFLINE (4)   ///< Error code for a device out of service after repeated failures.
 
 /**
  * @brief Device address of PCAL6524 (7Bit Form).
@@ -87,6 +103,47 @@ extern "C"
  */
 #define PCAL6524_ADDRESS (0x20)
 
+/**
+ * @brief Command byte flag that lets the chip step through consecutive registers.
+ */
+#define PCAL6524_AUTO_INCREMENT (0x80)
+
+/**
+ * @brief Size of the register map mirrored in the shadow image (0x00 - 0x77).
+ */
+#define PCAL6524_REG_MAP_SIZE (0x78)
+
+/**
+ * @brief Bus time of a write transaction besides its data bytes (start, address, command, stop) [byte].
+ * A batch commit bridges register gaps up to this length instead of starting a new transaction.
+ */
+#define PCAL6524_TRANSACTION_OVERHEAD (3)
+
+/**
+ * @brief Bus time of a read transaction besides its data bytes (start, address, command, restart, address, stop) [byte].
+ */
+#define PCAL6524_READ_OVERHEAD (4)
+
+/**
+ * @brief Number of I/O pins (three ports of eight).
+ */
+#define PCAL6524_PIN_COUNT (24)
+
+/**
+ * @brief Number of interrupt edge registers (A and B for each port, 0x60 - 0x65).
+ */
+#define PCAL6524_EDGE_REGISTERS (6)
+
+/**
+ * @brief Port argument of PCAL6524_CaptureInputs that rotates through ports A, B and C.
+ */
+#define PCAL6524_CAPTURE_ALL_PORTS (3)
+
+/**
+ * @brief Pin number used in pin group lists: bit of the pin in the 24-bit port word.
+ */
+#define PCAL6524_PIN(port, pin) ((uint8_t)((port) * 8 + (pin)))
+
 // Register addresses
 /**
  * @brief Register to read input pins and clearing the interrupt.
@@ -116,6 +173,13 @@ extern "C"
 #define PCAL6524_REG_CONF_PORT_1 (0x0D)
 #define PCAL6524_REG_CONF_PORT_2 (0x0E)
 
+/**
+ * @brief Register to hold input changes until the input port is read.
+ */
+#define PCAL6524_REG_IN_LATCH_PORT_0 (0x48)
+#define PCAL6524_REG_IN_LATCH_PORT_1 (0x49)
+#define PCAL6524_REG_IN_LATCH_PORT_2 (0x4A)
+
 /**
  * @brief Register to enable or disable pull-up/pull-down resistors.
  */
@@ -168,6 +232,17 @@ extern "C"
 #define PCAL6524_REG_IN_STATUS_PORT_1 (0x6D)
 #define PCAL6524_REG_IN_STATUS_PORT_2 (0x6E)
 
+/**
+ * @brief Register to enable switch debounce on port 0 and 1. P0_0 is the debounce clock input.
+ */
+#define PCAL6524_REG_DEBOUNCE_EN_PORT_0 (0x74)
+#define PCAL6524_REG_DEBOUNCE_EN_PORT_1 (0x75)
+
+/**
+ * @brief Register for the debounce time in cycles of the debounce clock.
+ */
+#define PCAL6524_REG_DEBOUNCE_COUNT (0x76)
+
     /**
      * @brief Enum for last two bits of device address.
      */
@@ -218,6 +293,30 @@ extern "C"
         PCAL6524_PolarityNormal,
         PCAL6524_PolarityInverted
     } pcal6524_Polarity_t;
+    /**
+     * @brief Enum for input latch.
+     */
+    typedef enum
+    {
+        PCAL6524_LatchDisabled,
+        PCAL6524_LatchEnabled
+    } pcal6524_Latch_t;
+    /**
+     * @brief Enum for the source of debounced input values.
+     */
+    typedef enum
+    {
+        PCAL6524_DebounceSoftware, ///< All pins are filtered by a window of reads.
+        PCAL6524_DebounceHardware  ///< Pins with hardware debounce are read once, only the others are filtered.
+    } pcal6524_DebounceMode_t;
+    /**
+     * @brief Enum for the registers sampled by PCAL6524_CaptureInputs.
+     */
+    typedef enum
+    {
+        PCAL6524_CaptureInputPort,  ///< IN_PORT: latched values where latches are enabled, clears interrupts.
+        PCAL6524_CaptureInputStatus ///< IN_STATUS: pin levels, interrupts stay pending.
+    } pcal6524_CaptureSource_t;
     /**
      * @brief Enum for interrupt trigger.
      */
@@ -261,13 +360,423 @@ extern "C"
     } pcal6524_Value_t;
 
     /**
-     * @brief Struct for I2C handler and address pin status.
+     * @brief Struct for statistics of a committed batch.
+     */
+    typedef struct
+    {
+        uint16_t transactions;      ///< Transactions issued by the commit.
+        uint16_t transactionsSaved; ///< Transactions saved against writing each change on its own, pin marks not counted.
+        uint16_t bytes;             ///< Bus bytes sent by the commit, including transaction overhead.
+        uint16_t bytesSaved;        ///< Bus bytes saved against writing each change on its own.
+    } pcal6524_BatchStats_t;
+
+    /**
+     * @brief Struct for configuration of all 24 pins, meant to be stored as const in flash.
+     * Bit 0-7 hold port A, bit 8-15 port B, bit 16-23 port C. Bits have the meaning of the chip registers.
+     */
+    typedef struct
+    {
+        uint32_t direction;     ///< 1 input, 0 output.
+        uint32_t polarity;      ///< 1 inverted input polarity.
+        uint32_t pullEnable;    ///< 1 pull-up/pull-down resistor connected.
+        uint32_t pullSelect;    ///< 1 pull-up, 0 pull-down.
+        uint32_t interruptMask; ///< 1 interrupt disabled.
+        uint64_t edge;          ///< Two bits per pin, pin n at bit 2n. Values as pcal6524_InterruptTrigger_t.
+        uint32_t output;        ///< Initial output latch.
+        uint32_t inputLatch;    ///< 1 input change held until the input port is read.
+    } pcal6524_Config_t;
+
+/**
+ * @brief Initializer with the power-on values of the chip, to be overridden per field.
+ */
+#define PCAL6524_CONFIG_DEFAULT                                                      \
+    {                                                                                \
+        .direction = 0xFFFFFF, .polarity = 0, .pullEnable = 0, .pullSelect = 0xFFFFFF, \
+        .interruptMask = 0xFFFFFF, .edge = 0, .output = 0xFFFFFF, .inputLatch = 0    \
+    }
+
+    /**
+     * @brief Enum for the growth of the wait between repeated attempts.
+     */
+    typedef enum
+    {
+        PCAL6524_BackoffConstant,   ///< Base delay before every repetition.
+        PCAL6524_BackoffLinear,     ///< Base delay times the number of failed attempts.
+        PCAL6524_BackoffExponential ///< Base delay doubled with every failed attempt.
+    } pcal6524_Backoff_t;
+
+    /**
+     * @brief Struct for the retry policy of transfers failing with HAL_BUSY or HAL_TIMEOUT.
      */
     typedef struct
+    {
+        uint8_t maxAttempts;        ///< Attempts including the first one. 0 selects PCAL6524_RETRY_POLICY_DEFAULT on init.
+        pcal6524_Backoff_t backoff; ///< Growth of the wait between attempts.
+        uint32_t baseDelayUs;       ///< Wait before the first repetition [us].
+        uint32_t maxDelayUs;        ///< Upper limit of a single wait [us].
+        uint32_t deadlineUs;        ///< No repetition starts later than this after the first attempt [us]. 0 for none.
+    } pcal6524_RetryPolicy_t;
+
+/**
+ * @brief Initializer for the default retry policy.
+ */
+#define PCAL6524_RETRY_POLICY_DEFAULT                                                         \
+    {                                                                                         \
+        .maxAttempts = PCAL6524_I2C_MAX_ATTEMPTS + 1, .backoff = PCAL6524_BackoffExponential, \
+        .baseDelayUs = PCAL6524_I2C_ATTEMPT_DELAY, .maxDelayUs = PCAL6524_I2C_MAX_DELAY,      \
+        .deadlineUs = PCAL6524_I2C_DEADLINE                                                   \
+    }
+
+    /**
+     * @brief Struct for statistics of the retry engine.
+     */
+    typedef struct
+    {
+        uint32_t transfers;   ///< Transfers finished by the retry engine.
+        uint32_t retries;     ///< Repeated attempts.
+        uint32_t recovered;   ///< Transfers that succeeded after a repetition.
+        uint32_t exhausted;   ///< Transfers given up after the last attempt or the deadline.
+        uint32_t rescheduled; ///< Repetitions of asynchronous transfers run in the background instead of waiting.
+        uint32_t waitUs;      ///< Time waited between attempts of blocking calls [us].
+    } pcal6524_RetryStats_t;
+
+    /**
+     * @brief Struct for the timestamped copy of the input levels (IN_STATUS), kept apart from the shadow image.
+     */
+    typedef struct
+    {
+        uint32_t values;    ///< Input levels. Bit 0-7 port A, bit 8-15 port B, bit 16-23 port C.
+        uint32_t timestamp; ///< Cycle count (DWT) when values were read.
+        uint32_t tick;      ///< HAL tick when values were read, guards against cycle counter wrap-around.
+        uint8_t valid;      ///< Set once values were read.
+        uint32_t hits;      ///< Reads served from values.
+        uint32_t misses;    ///< Reads that went to the bus.
+    } pcal6524_InputCache_t;
+
+    /**
+     * @brief Struct for a named group of pins read and written as one value, built by PCAL6524_InitPinGroup.
+     * Pins that follow each other in the group and on the chip form a run, moved with one mask and shift.
+     */
+    typedef struct
+    {
+        uint8_t width;                           ///< Number of pins, group bit 0 is the first pin of the list.
+        uint8_t firstPort;                       ///< Lowest port holding a pin of the group.
+        uint8_t portCount;                       ///< Ports from firstPort up to the highest port holding a pin.
+        uint8_t portMask[3];                     ///< Pins of the group per port.
+        uint8_t runCount;                        ///< Entries used in runMask and runShift.
+        uint32_t runMask[PCAL6524_PIN_COUNT];    ///< Chip bits (port * 8 + pin) of each run.
+        int8_t runShift[PCAL6524_PIN_COUNT];     ///< Chip bit minus group bit of each run.
+    } pcal6524_PinGroup_t;
+
+    /**
+     * @brief Enum for the service state of a device.
+     */
+    typedef enum
+    {
+        PCAL6524_HealthOnline, ///< Transfers are carried out.
+        PCAL6524_HealthOffline ///< Transfers fail fast, PCAL6524_ServiceHealth probes the device.
+    } pcal6524_HealthState_t;
+
+    /**
+     * @brief Struct for health tracking of a device (circuit breaker).
+     */
+    typedef struct
+    {
+        pcal6524_HealthState_t state; ///< Service state.
+        uint8_t failures;             ///< Consecutive failed transfers.
+        uint32_t since;               ///< HAL tick of the last state change or probe.
+        uint16_t trips;               ///< Times the device was taken out of service.
+        uint16_t recoveries;          ///< Times the device returned and got its registers replayed.
+        uint8_t watchReg;             ///< Register checked for a power-on reset, 0 if none is chosen.
+        uint32_t watchTick;           ///< HAL tick of the last reset check.
+        uint16_t resets;              ///< Power-on resets detected and repaired by replaying the registers.
+    } pcal6524_Health_t;
+
+    /**
+     * @brief Struct for the bus speed a device settled on.
+     */
+    typedef struct
+    {
+        uint32_t clockSpeed;  ///< Effective SCL frequency [Hz], 0 until negotiated.
+        uint8_t level;        ///< Index into the speed table, 0 is fastest.
+        uint8_t errors;       ///< Failed transfers in the current window.
+        uint32_t windowStart; ///< HAL tick the error window started.
+    } pcal6524_BusSpeed_t;
+
+    /**
+     * @brief Struct for an input change reported by the INT pin.
+     */
+    typedef struct
+    {
+        uint32_t changed;   ///< Pins that raised the interrupt (INT_STAT). Bit 0-7 port A, bit 8-15 port B, bit 16-23 port C.
+        uint32_t state;     ///< Input levels read after the edge (IN_STATUS, or latched IN_PORT if any latch is enabled), same bit order.
+        uint32_t timestamp; ///< Cycle count (DWT) at the falling edge of INT.
+    } pcal6524_Event_t;
+
+    /**
+     * @brief Struct for the INT pin event pipeline. The ring is written only by the interrupt
+     * and read only by the application, so it needs no lock.
+     */
+    typedef struct
+    {
+        GPIO_TypeDef *intPort;                              ///< Port of the INT pin, NULL if the level is not checked.
+        uint16_t intPin;                                    ///< INT pin, re-checked after clearing to catch edges missed meanwhile.
+        pcal6524_Event_t ring[PCAL6524_EVENT_QUEUE_SIZE];   ///< Recorded events.
+        volatile uint8_t head;                              ///< Free-running index of the next slot written.
+        volatile uint8_t tail;                              ///< Free-running index of the next slot read.
+        uint16_t dropped;                                   ///< Events lost because the ring was full.
+        volatile uint8_t busy;                              ///< Set while the transfers of an edge run.
+        volatile uint8_t pending;                           ///< Set if another edge arrived meanwhile.
+        uint8_t failed;                                     ///< Set if the INT_STAT read failed.
+        volatile uint8_t statDone;                          ///< Set once the INT_STAT read of the running edge completed.
+        volatile uint8_t orphan;                            ///< Set if the queued INT_STAT read has to end the edge on its own.
+        uint32_t timestamp;                                 ///< Edge time of the running transfers.
+        uint8_t intStat[3];                                 ///< Buffer for INT_STAT.
+        uint8_t inStatus[3];                                ///< Buffer for IN_STATUS.
+        uint8_t intClear[3];                                ///< Buffer for INT_CLEAR.
+    } pcal6524_EventPipe_t;
+
+    /**
+     * @brief Enum for the way I2C transfers are carried out.
+     */
+    typedef enum
+    {
+        PCAL6524_TransportBlocking, ///< Blocking HAL calls.
+        PCAL6524_TransportDMA,      ///< HAL DMA calls. API calls wait for completion, *Async calls return at once. Starts from interrupt context are left to PCAL6524_ServiceRetries.
+        PCAL6524_TransportIT,       ///< HAL interrupt calls, fully interrupt driven and startable from interrupts. Same semantics as DMA otherwise.
+        PCAL6524_TransportLL        ///< Blocking register-level (LL) sequences without HAL overhead. STM32F1 only.
+    } pcal6524_Transport_t;
+
+    typedef struct pcal6524_Device_s pcal6524_Device_t;
+
+    /**
+     * @brief Function called when an asynchronous transfer completes. Runs in interrupt context
+     * and must not call blocking driver functions.
+     */
+    typedef void (*pcal6524_Callback_t)(pcal6524_Device_t *device, uint8_t status, void *context);
+
+    /**
+     * @brief Struct for an I2C transfer handed to the transport.
+     */
+    typedef struct
+    {
+        pcal6524_Device_t *device;    ///< Device addressed by the transfer.
+        uint8_t command;              ///< Command byte: register address and auto-increment flag.
+        uint8_t read;                 ///< 1 for read, 0 for write.
+        uint8_t *data;                ///< Buffer read into or written from. Must stay valid until completion.
+        uint16_t len;                 ///< Number of data bytes.
+        pcal6524_Callback_t callback; ///< Called on completion, may be NULL.
+        void *context;                ///< Passed to callback.
+        uint8_t reschedule;           ///< Set by the driver if failed attempts are repeated in the background.
+        uint8_t attempts;             ///< Attempts started so far, kept by the driver.
+        uint32_t start;               ///< Cycle count of the first attempt, kept by the driver.
+        uint32_t due;                 ///< Cycle count of the next attempt, kept by the driver.
+    } pcal6524_Request_t;
+
+    /**
+     * @brief Struct for I2C handler and address pin status.
+     */
+    struct pcal6524_Device_s
     {
         I2C_HandleTypeDef *hi2c;
         pcal6524_A0_t a0;
-    } pcal6524_Device_t;
+        pcal6524_Transport_t transport;                          ///< Way I2C transfers are carried out.
+        uint8_t shadow[PCAL6524_REG_MAP_SIZE];                  ///< Last known content of the writable registers.
+        uint32_t shadowValid[(PCAL6524_REG_MAP_SIZE + 31) / 32]; ///< One bit per register, set if shadow matches chip.
+        uint32_t shadowDirty[(PCAL6524_REG_MAP_SIZE + 31) / 32]; ///< One bit per register, set if a batch still has to write it.
+        uint8_t batchActive;                                     ///< Set while setters are recorded instead of sent.
+        uint16_t batchChanges;                                   ///< Register writes deferred by the current batch.
+        pcal6524_BatchStats_t batchStats;                        ///< Statistics of the last committed batch.
+        pcal6524_RetryPolicy_t retry;                            ///< Handling of transfers failing with HAL_BUSY or HAL_TIMEOUT.
+        pcal6524_RetryStats_t retryStats;                        ///< Statistics of the retry engine.
+        pcal6524_Health_t health;                                ///< Service state of the device.
+        pcal6524_BusSpeed_t busSpeed;                            ///< Speed of the I2C bus, shared by all devices on it.
+        pcal6524_EventPipe_t events;                             ///< Input changes reported by the INT pin.
+        pcal6524_DebounceMode_t debounceMode;                    ///< Source of PCAL6524_GetDebouncedInputs values.
+        uint32_t debounced;                                      ///< Last stable input levels of the software filter.
+        uint8_t restored;                                        ///< Set by PCAL6524_Init if the retained shadow image still matched the chip.
+        pcal6524_InputCache_t inputCache;                        ///< Last input levels read by PCAL6524_GetCachedInputs.
+    };
+
+    /**
+     * @brief 				Initializes driver state and warms the shadow image with all writable registers.
+     * 						Sets the default retry policy unless device->retry was filled in.
+     * 						After a warm restart the image kept in retained RAM (.noinit) is checked against the
+     * 						output, polarity and configuration registers with one burst read; if it matches, it is
+     * 						taken over without further transfers and device->restored is set. Registers whose last
+     * 						write failed are not taken over and are read from the chip on first use. Setters called
+     * 						afterwards with the values the chip already holds send nothing, so outputs do not glitch.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_Init(pcal6524_Device_t *device);
+
+    /**
+     * @brief 				Re-reads all writable registers from the chip into the shadow image.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_RefreshShadow(pcal6524_Device_t *device);
+
+    /**
+     * @brief 				Marks the shadow image as stale, so the next access of each register reads the chip.
+     * 						Discards changes of an open batch.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     */
+    void PCAL6524_InvalidateShadow(pcal6524_Device_t *device);
+
+    /**
+     * @brief 				Starts recording register changes of setters instead of sending them.
+     * 						Getters return the recorded values while the batch is open.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     */
+    void PCAL6524_BeginBatch(pcal6524_Device_t *device);
+
+    /**
+     * @brief 				Ends the batch and writes all changed registers in the fewest auto-increment bursts.
+     * 						Statistics of the commit are stored in device->batchStats.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_CommitBatch(pcal6524_Device_t *device);
+
+    /**
+     * @brief 				Writes a whole-device configuration in auto-increment bursts.
+     * 						Output latch, polarity, pull select and edges are written first with new
+     * 						interrupts still masked, then pull enable and direction, then the final mask.
+     * 						Registers already holding the wanted value are skipped. Must not be called while
+     * 						a batch is open, since each phase is committed on its own.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	*config 	Configuration to apply.
+     * @param 	*previous 	Configuration known to be on the chip, or NULL to compare against the shadow image.
+     *
+     * @retval 	uint8_t		Error code. HAL_BUSY while a batch is open.
+     */
+    uint8_t PCAL6524_ApplyConfig(pcal6524_Device_t *device, const pcal6524_Config_t *config, const pcal6524_Config_t *previous);
+
+    /**
+     * @brief 				Starts reading consecutive registers and returns without waiting for the data.
+     * 						Transfers are queued while the bus is busy and started from the I2C interrupts.
+     * 						With blocking or LL transport the read is done before returning and callback is called at once.
+     * 						Failed attempts are repeated by the retry policy before callback reports the failure.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	reg 		First register.
+     * @param 	*data 		Buffer for register values. Must stay valid until completion.
+     * @param 	len 		Number of registers.
+     * @param 	callback 	Called on completion with the transfer status, may be NULL.
+     * @param 	*context 	Passed to callback.
+     *
+     * @retval 	uint8_t		Error code. HAL_BUSY if the queue is full.
+     */
+    uint8_t PCAL6524_ReadAsync(pcal6524_Device_t *device, uint8_t reg, uint8_t *data, uint16_t len, pcal6524_Callback_t callback, void *context);
+
+    /**
+     * @brief 				Starts writing consecutive registers and returns without waiting for the bus.
+     * 						The shadow image is updated on completion.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	reg 		First register.
+     * @param 	*data 		Register values. Must stay valid until completion.
+     * @param 	len 		Number of registers.
+     * @param 	callback 	Called on completion with the transfer status, may be NULL.
+     * @param 	*context 	Passed to callback.
+     *
+     * @retval 	uint8_t		Error code. HAL_BUSY if the queue is full.
+     */
+    uint8_t PCAL6524_WriteAsync(pcal6524_Device_t *device, uint8_t reg, uint8_t *data, uint16_t len, pcal6524_Callback_t callback, void *context);
+
+    /**
+     * @brief 				Starts streaming output frames to one port, see PCAL6524_StreamOutputs.
+     * 						With DMA transport the CPU is free while the frames go out.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	port 		Port to drive.
+     * @param 	*frames 	Output register values in order. Must stay valid until completion.
+     * @param 	n 			Number of frames.
+     * @param 	callback 	Called on completion with the transfer status, may be NULL.
+     * @param 	*context 	Passed to callback.
+     *
+     * @retval 	uint8_t		Error code. HAL_BUSY if the queue is full, a batch is open or the output register is pending.
+     */
+    uint8_t PCAL6524_StreamOutputsAsync(pcal6524_Device_t *device, pcal6524_Port_t port, const uint8_t *frames, uint16_t n, pcal6524_Callback_t callback, void *context);
+
+    /**
+     * @brief 				Checks whether an asynchronous transfer of the device is in flight or queued.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     *
+     * @retval 	uint8_t		1 while in flight, 0 otherwise.
+     */
+    uint8_t PCAL6524_IsBusy(pcal6524_Device_t *device);
+
+    /**
+     * @brief 				Starts an asynchronous transfer whose repetition is due. Failed asynchronous
+     * 						transfers wait on the bus until then instead of blocking the caller. DMA transfers
+     * 						queued or chained from interrupt context wait here as well, since the HAL sends
+     * 						their address phase by polling.
+     * 						Call regularly from the main loop; blocking driver calls call it while waiting.
+     */
+    void PCAL6524_ServiceRetries(void);
+
+    /**
+     * @brief 				Probes a device taken out of service, at most once per PCAL6524_BREAKER_COOLDOWN.
+     * 						When it answers again, the registers known before the outage are written back
+     * 						in the fewest bursts (or added to an open batch) and the device returns to service.
+     * 						Call regularly from the main loop.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     *
+     * @retval 	uint8_t		Error code. PCAL6524_DEVICEOFFLINE while out of service.
+     */
+    uint8_t PCAL6524_ServiceHealth(pcal6524_Device_t *device);
+
+    /**
+     * @brief 				Detects a power-on reset (brown-out) of the chip, at most once per PCAL6524_RESET_CHECK_INTERVAL.
+     * 						Reads a single register whose shadow value differs from its power-on value; on a mismatch
+     * 						the registers known to the shadow image are written back in the fewest bursts (or added
+     * 						to an open batch). Nothing is read while every known register holds its power-on value.
+     * 						Call regularly from the main loop.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     *
+     * @retval 	uint8_t		Error code. PCAL6524_DEVICEOFFLINE while out of service.
+     */
+    uint8_t PCAL6524_ServiceReset(pcal6524_Device_t *device);
+
+#if defined(STM32F1)
+    /**
+     * @brief 				Brings the bus up at 400 kHz (duty cycle 16/9) and verifies the link by reading the
+     * 						direction registers PCAL6524_LINK_CHECK_READS times against the shadow image.
+     * 						Steps down to 100 kHz on any error. PCAL6524_ServiceHealth steps down later
+     * 						if errors rise. The settled speed is reported in device->busSpeed.
+     * 						Call after PCAL6524_Init.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     *
+     * @retval 	uint8_t		Error code. HAL_ERROR if no speed passed the verification.
+     */
+    uint8_t PCAL6524_NegotiateBusSpeed(pcal6524_Device_t *device);
+#endif
+
+    /**
+     * @brief 				Completion hook for HAL I2C memory transfers. Called by the HAL callbacks
+     * 						defined in the driver; if PCAL6524_NO_HAL_CALLBACKS is defined the application
+     * 						has to call it from its own HAL_I2C_MemTxCpltCallback, MemRxCpltCallback and ErrorCallback.
+     *
+     * @param   hi2c        I2C handler that finished the transfer.
+     * @param 	status 		HAL_OK on completion, HAL_ERROR on error.
+     */
+    void PCAL6524_I2C_TransferCallback(I2C_HandleTypeDef *hi2c, uint8_t status);
 
     /**
      * @brief 				Defines whether a pin is an in- or output.
@@ -282,7 +791,7 @@ extern "C"
     uint8_t PCAL6524_SetInOut(pcal6524_Device_t *device, pcal6524_Port_t port, pcal6524_Pin_t pin, pcal6524_InOut_t io);
 
     /**
-     * @brief 				Gets the current in-, output configuration for selected port.
+     * @brief 				Gets the current in-, output configuration for selected port (served from shadow image).
      *
      * @param   device      Struct with I2C handler and address pin status.
      * @param 	port 		Selected Port.
@@ -305,7 +814,7 @@ extern "C"
     uint8_t PCAL6524_SetInterrupt(pcal6524_Device_t *device, pcal6524_Port_t port, pcal6524_Pin_t pin, pcal6524_InterruptEN_t intr);
 
     /**
-     * @brief 				Gets current interrupt mask for selected port.
+     * @brief 				Gets current interrupt mask for selected port (served from shadow image).
      *
      * @param   device      Struct with I2C handler and address pin status.
      * @param 	port 		Selected port.
@@ -329,7 +838,7 @@ extern "C"
     uint8_t PCAL6524_SetPullupDown(pcal6524_Device_t *device, pcal6524_Port_t port, pcal6524_Pin_t pin, pcal6524_PullUpDown_t pull, pcal6524_PullUpDownEN_t active);
 
     /**
-     * @brief 				Gets current pull-up/pull-down configuration for selected port.
+     * @brief 				Gets current pull-up/pull-down configuration for selected port (served from shadow image).
      *
      * @param   device      Struct with I2C handler and address pin status.
      * @param 	port 		Selected port.
@@ -353,7 +862,7 @@ extern "C"
     uint8_t PCAL6524_SetPolarity(pcal6524_Device_t *device, pcal6524_Port_t port, pcal6524_Pin_t pin, pcal6524_Polarity_t pol);
 
     /**
-     * @brief 				Gets current polarity configuration for selected port.
+     * @brief 				Gets current polarity configuration for selected port (served from shadow image).
      *
      * @param   device      Struct with I2C handler and address pin status.
      * @param 	port 		Selected port.
@@ -364,82 +873,637 @@ extern "C"
     uint8_t PCAL6524_GetPolarityConfig(pcal6524_Device_t *device, pcal6524_Port_t port, uint8_t *pol);
 
     /**
-     * @brief 				Sets trigger for interrupt for selected pin.
+     * @brief 				Enables or disables the input latch of selected pin. A latched input holds
+     * 						its first change until the input port is read, so short pulses are not lost.
      *
      * @param   device      Struct with I2C handler and address pin status.
      * @param 	port 		Port of the pin.
      * @param 	pin 		Selected pin.
-     * @param 	trig 		0b00 trigger at change, 0b01 rising edge, 0b10 falling edge, 0b11 any edge.
+     * @param 	latch 		Set to 1 to latch and to 0 for transparent input.
      *
      * @retval 	uint8_t		Error code.
      */
-    uint8_t PCAL6524_SetInterruptTrigger(pcal6524_Device_t *device, pcal6524_Port_t port, pcal6524_Pin_t pin, pcal6524_InterruptTrigger_t trig);
+    uint8_t PCAL6524_SetInputLatch(pcal6524_Device_t *device, pcal6524_Port_t port, pcal6524_Pin_t pin, pcal6524_Latch_t latch);
 
     /**
-     * @brief 				Gets current interrupt trigger configuration for selected port.
+     * @brief 				Sets the input latch of all pins of selected port.
      *
      * @param   device      Struct with I2C handler and address pin status.
      * @param 	port 		Selected port.
-     * @param 	*trig 		Pointer to output variable for trigger configuration. 0b00 trigger at change, 0b01 rising edge, 0b10 falling edge, 0b11 any edge.
+     * @param 	latches 	One bit per pin, 1 latched.
      *
      * @retval 	uint8_t		Error code.
      */
-    uint8_t PCAL6524_GetInterruptTriggerConfig(pcal6524_Device_t *device, pcal6524_Port_t port, pcal6524_Pin_t pin, pcal6524_InterruptTrigger_t *trig);
+    uint8_t PCAL6524_SetPortInputLatch(pcal6524_Device_t *device, pcal6524_Port_t port, uint8_t latches);
 
     /**
-     * @brief	 			Get value of selected pin.
+     * @brief 				Gets current input latch configuration for selected port (served from shadow image).
      *
      * @param   device      Struct with I2C handler and address pin status.
-     * @param 	port 		Port of the pin.
+     * @param 	port 		Selected port.
+     * @param 	*latches 	Pointer to output variable for latch configuration.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_GetInputLatchConfig(pcal6524_Device_t *device, pcal6524_Port_t port, uint8_t *latches);
+
+    /**
+     * @brief 				Enables or disables hardware debounce of selected pin. Only port A and B
+     * 						can be debounced, P0_0 is the debounce clock input.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	port 		Port of the pin (A or B).
      * @param 	pin 		Selected pin.
-     * @param 	*value 		Pointer to output variable.
+     * @param 	enable 		Set to 1 to debounce.
      *
      * @retval 	uint8_t		Error code.
      */
-    uint8_t PCAL6524_GetPinValue(pcal6524_Device_t *device, pcal6524_Port_t port, pcal6524_Pin_t pin, pcal6524_Value_t *value);
+    uint8_t PCAL6524_SetDebounce(pcal6524_Device_t *device, pcal6524_Port_t port, pcal6524_Pin_t pin, uint8_t enable);
 
     /**
-     * @brief 				Get value of selected port.
+     * @brief 				Sets the debounce time.
      *
      * @param   device      Struct with I2C handler and address pin status.
-     * @param 	port 		Selected port.
-     * @param 	*values 	Pointer to output variable.
+     * @param 	count 		Cycles of the debounce clock an input has to be stable.
      *
      * @retval 	uint8_t		Error code.
      */
-    uint8_t PCAL6524_GetPortPinValues(pcal6524_Device_t *device, pcal6524_Port_t port, uint8_t *values);
+    uint8_t PCAL6524_SetDebounceCount(pcal6524_Device_t *device, uint8_t count);
 
     /**
-     * @brief 				Gets interrupt register of selected port.
+     * @brief 				Gets current debounce configuration (served from shadow image).
      *
      * @param   device      Struct with I2C handler and address pin status.
-     * @param 	port 		Selected port.
-     * @param 	*values 	Pointer to output variable.
+     * @param 	*pins 		Pointer to output variable for debounced pins. Bit 0-7 port A, bit 8-15 port B.
+     * @param 	*count 		Pointer to output variable for the debounce count.
      *
      * @retval 	uint8_t		Error code.
      */
-    uint8_t PCAL6524_GetInterrupts(pcal6524_Device_t *device, pcal6524_Port_t port, uint8_t *intr);
+    uint8_t PCAL6524_GetDebounceConfig(pcal6524_Device_t *device, uint16_t *pins, uint8_t *count);
 
     /**
-     * @brief	 			Clears interrupt register and -pin.
+     * @brief 				Sets up hardware debounce in one batch: P0_0 becomes the clock input (input, no pull,
+     * 						no latch, interrupt masked), the selected pins are debounced with the given count,
+     * 						and debounceMode switches to hardware. The clock has to be fed to P0_0 externally,
+     * 						e.g. from a timer output of the MCU.
      *
      * @param   device      Struct with I2C handler and address pin status.
+     * @param 	pins 		Pins to debounce. Bit 0-7 port A, bit 8-15 port B. P0_0 is ignored.
+     * @param 	count 		Cycles of the debounce clock an input has to be stable.
      *
      * @retval 	uint8_t		Error code.
      */
-    uint8_t PCAL6524_ClearAllInterrupts(pcal6524_Device_t *device);
+    uint8_t PCAL6524_ConfigureDebounce(pcal6524_Device_t *device, uint16_t pins, uint8_t count);
 
     /**
-     * @brief 				Outputs a value on selected pin. Only works if pin is set to output.
+     * @brief 				Sets trigger for interrupt for selected pin.
      *
      * @param   device      Struct with I2C handler and address pin status.
      * @param 	port 		Port of the pin.
      * @param 	pin 		Selected pin.
-     * @param 	value 		Output value.
+     * @param 	trig 		0b00 trigger at change, 0b01 rising edge, 0b10 falling edge, 0b11 any edge.
      *
      * @retval 	uint8_t		Error code.
      */
-    uint8_t PCAL6524_OutputValue(pcal6524_Device_t *device, pcal6524_Port_t port, pcal6524_Pin_t pin, pcal6524_Value_t value);
+    uint8_t PCAL6524_SetInterruptTrigger(pcal6524_Device_t *device, pcal6524_Port_t port, pcal6524_Pin_t pin, pcal6524_InterruptTrigger_t trig);
+
+    /**
+     * @brief 				Gets current interrupt trigger configuration for selected pin (served from shadow image).
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	port 		Port of the pin.
+     * @param 	pin 		Selected pin.
+     * @param 	*trig 		Pointer to output variable for trigger configuration. 0b00 trigger at change, 0b01 rising edge, 0b10 falling edge, 0b11 any edge.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_GetInterruptTriggerConfig(pcal6524_Device_t *device, pcal6524_Port_t port, pcal6524_Pin_t pin, pcal6524_InterruptTrigger_t *trig);
+
+    /**
+     * @brief 				Sets the interrupt trigger of all 24 pins. The six edge registers are written in one
+     * 						auto-increment transaction (only the span that differs from the shadow image), or
+     * 						recorded in an open batch.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	edges 		Two bits per pin, pin n (port * 8 + pin) at bit 2n. Values as pcal6524_InterruptTrigger_t.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_SetAllInterruptTriggers(pcal6524_Device_t *device, uint64_t edges);
+
+    /**
+     * @brief 				Sets the interrupt trigger of all 24 pins from a per-pin array, see PCAL6524_SetAllInterruptTriggers.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	*trigs 		Array of PCAL6524_PIN_COUNT triggers, index port * 8 + pin.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_SetInterruptTriggerArray(pcal6524_Device_t *device, const pcal6524_InterruptTrigger_t *trigs);
+
+    /**
+     * @brief 				Gets the interrupt trigger of all 24 pins (served from shadow image, missing registers
+     * 						are fetched in one transaction).
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	*edges 		Pointer to output variable, same layout as in PCAL6524_SetAllInterruptTriggers.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_GetAllInterruptTriggers(pcal6524_Device_t *device, uint64_t *edges);
+
+    /**
+     * @brief 				Gets the interrupt trigger of all 24 pins as a per-pin array, see PCAL6524_GetAllInterruptTriggers.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	*trigs 		Array of PCAL6524_PIN_COUNT entries for the triggers, index port * 8 + pin.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_GetInterruptTriggerArray(pcal6524_Device_t *device, pcal6524_InterruptTrigger_t *trigs);
+
+    /**
+     * @brief	 			Get value of selected pin.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	port 		Port of the pin.
+     * @param 	pin 		Selected pin.
+     * @param 	*value 		Pointer to output variable.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_GetPinValue(pcal6524_Device_t *device, pcal6524_Port_t port, pcal6524_Pin_t pin, pcal6524_Value_t *value);
+
+    /**
+     * @brief 				Get value of selected port.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	port 		Selected port.
+     * @param 	*values 	Pointer to output variable.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_GetPortPinValues(pcal6524_Device_t *device, pcal6524_Port_t port, uint8_t *values);
+
+    /**
+     * @brief 				Gets values of all 24 pins in one transaction.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	*mask 		Pointer to output variable. Bit 0-7 port A, bit 8-15 port B, bit 16-23 port C.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_GetAllPinValues(pcal6524_Device_t *device, uint32_t *mask);
+
+    /**
+     * @brief 				Gets the input levels of all 24 pins, served from device->inputCache if they were read
+     * 						no longer than maxAge ago. Otherwise all ports are read from IN_STATUS in one transaction.
+     * 						Interrupts are neither cleared nor acknowledged.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	maxAge 		Oldest accepted reading [us], below 50 s. 0 always reads the chip.
+     * @param 	*values 	Pointer to output variable. Bit 0-7 port A, bit 8-15 port B, bit 16-23 port C.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_GetCachedInputs(pcal6524_Device_t *device, uint32_t maxAge, uint32_t *values);
+
+    /**
+     * @brief 				Gets the input level of one pin, see PCAL6524_GetCachedInputs.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	port 		Port of the pin.
+     * @param 	pin 		Selected pin.
+     * @param 	maxAge 		Oldest accepted reading [us], below 50 s. 0 always reads the chip.
+     * @param 	*value 		Pointer to output variable.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_GetCachedPinValue(pcal6524_Device_t *device, pcal6524_Port_t port, pcal6524_Pin_t pin, uint32_t maxAge, pcal6524_Value_t *value);
+
+    /**
+     * @brief 				Builds a pin group from a pin list and precomputes its port masks and shift table.
+     *
+     * @param 	*group 		Pin group to fill.
+     * @param 	*pins 		Pins from group bit 0 upwards, each PCAL6524_PIN(port, pin). Every pin at most once.
+     * @param 	count 		Number of pins, 1 to PCAL6524_PIN_COUNT.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_InitPinGroup(pcal6524_PinGroup_t *group, const uint8_t *pins, uint8_t count);
+
+    /**
+     * @brief 				Reads the value of a pin group from the input registers of its ports in one transaction.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	*group 		Pin group built by PCAL6524_InitPinGroup.
+     * @param 	*value 		Pointer to output variable, group bit n holds the level of pin n of the list.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_ReadPinGroup(pcal6524_Device_t *device, const pcal6524_PinGroup_t *group, uint32_t *value);
+
+    /**
+     * @brief 				Writes the value of a pin group to the output registers of its ports in one transaction
+     * 						(only the span that differs from the shadow image), or records it in an open batch.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	*group 		Pin group built by PCAL6524_InitPinGroup.
+     * @param 	value 		Group value, bit n drives pin n of the list. Bits above the group width are ignored.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_WritePinGroup(pcal6524_Device_t *device, const pcal6524_PinGroup_t *group, uint32_t value);
+
+    /**
+     * @brief 				Samples inputs back-to-back. A single port is read in one long transaction with the
+     * 						auto-increment flag cleared, so only the first sample pays the addressing overhead.
+     * 						With PCAL6524_CAPTURE_ALL_PORTS the ports A - C are read by one auto-increment transaction
+     * 						per pass, since the address keeps counting past port C, so every three samples pay it.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	source 		Registers to sample.
+     * @param 	port 		Port to sample, or PCAL6524_CAPTURE_ALL_PORTS for samples of port A, B, C, A, ...
+     * @param 	*samples 	Buffer for the samples in bus order.
+     * @param 	n 			Number of samples.
+     * @param 	*period 	Pointer to output variable for the effective sample period [ns], may be NULL.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_CaptureInputs(pcal6524_Device_t *device, pcal6524_CaptureSource_t source, uint8_t port, uint8_t *samples, uint16_t n, uint32_t *period);
+
+    /**
+     * @brief 				Gets interrupt register of selected port.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	port 		Selected port.
+     * @param 	*values 	Pointer to output variable.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_GetInterrupts(pcal6524_Device_t *device, pcal6524_Port_t port, uint8_t *intr);
+
+    /**
+     * @brief	 			Clears interrupt register and -pin.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_ClearAllInterrupts(pcal6524_Device_t *device);
+
+    /**
+     * @brief 				Gets interrupt status and input levels of all 24 pins and clears the handled ones.
+     * 						Reads INT_STAT and IN_STATUS in two short bursts, which always cost fewer bus bytes
+     * 						than one burst over 0x58-0x6E, then clears the handled pins in one burst.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	*changed 	Output variable for pins that raised the interrupt. Bit 0-7 port A, bit 8-15 port B, bit 16-23 port C.
+     * @param 	*state 		Output variable for the input levels, same bit order.
+     * @param 	handleMask 	Pins the caller handles. Only reported pins within it are cleared.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_ServiceInterrupt(pcal6524_Device_t *device, uint32_t *changed, uint32_t *state, uint32_t handleMask);
+
+    /**
+     * @brief 				Gets the latched input edges of all 24 pins. Reads INT_STAT, then the input port,
+     * 						which returns the level each latched pin captured at its change and releases
+     * 						the latches and the interrupt.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	*changed 	Output variable for pins that changed since the last read (interrupt must be enabled).
+     * 						Bit 0-7 port A, bit 8-15 port B, bit 16-23 port C.
+     * @param 	*levels 	Output variable for the latched levels, same bit order. Pins without latch report the current level.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_GetLatchedInputs(pcal6524_Device_t *device, uint32_t *changed, uint32_t *levels);
+
+    /**
+     * @brief 				Gets debounced input levels without touching the interrupt. In hardware mode pins
+     * 						debounced by the chip are trusted after one read; remaining pins are sampled
+     * 						PCAL6524_DEBOUNCE_SAMPLES times and only take a new level when all samples agree.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	pins 		Pins of interest. Bit 0-7 port A, bit 8-15 port B, bit 16-23 port C.
+     * @param 	*values 	Output variable for the debounced levels, same bit order.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_GetDebouncedInputs(pcal6524_Device_t *device, uint32_t pins, uint32_t *values);
+
+    /**
+     * @brief 				Outputs a value on selected pin. Only works if pin is set to output.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	port 		Port of the pin.
+     * @param 	pin 		Selected pin.
+     * @param 	value 		Output value.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_OutputValue(pcal6524_Device_t *device, pcal6524_Port_t port, pcal6524_Pin_t pin, pcal6524_Value_t value);
+
+    /**
+     * @brief 				Sets and clears several output pins of all ports in one transaction.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	setMask 	Pins to drive high. Bit 0-7 port A, bit 8-15 port B, bit 16-23 port C.
+     * @param 	clearMask 	Pins to drive low. Pins present in both masks are driven high.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_WriteOutputsMasked(pcal6524_Device_t *device, uint32_t setMask, uint32_t clearMask);
+
+    /**
+     * @brief 				Marks a new output value of one pin in the shadow image without a transfer; the next
+     * 						PCAL6524_CommitBatch sends it. The bit is changed through its bit-band alias, so
+     * 						interrupt and main-loop code may mark pins of the same port without a critical section.
+     * 						Setters merge only their own pins into the image, so marks survive them. Marks are not
+     * 						counted in pcal6524_BatchStats_t. Raw register writes, streams, configuration loads and
+     * 						PCAL6524_RefreshShadow replace whole registers and must not be mixed with marks on one
+     * 						register before the commit.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	port 		Port of the pin.
+     * @param 	pin 		Selected pin.
+     * @param 	value 		Value to output.
+     *
+     * @retval 	uint8_t		Error code. HAL_ERROR if the register is not in the shadow image.
+     */
+    uint8_t PCAL6524_MarkOutput(pcal6524_Device_t *device, pcal6524_Port_t port, pcal6524_Pin_t pin, pcal6524_Value_t value);
+
+    /**
+     * @brief 				Marks a new direction of one pin in the shadow image, see PCAL6524_MarkOutput.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	port 		Port of the pin.
+     * @param 	pin 		Selected pin.
+     * @param 	io 			0 for output, 1 for input.
+     *
+     * @retval 	uint8_t		Error code. HAL_ERROR if the register is not in the shadow image.
+     */
+    uint8_t PCAL6524_MarkInOut(pcal6524_Device_t *device, pcal6524_Port_t port, pcal6524_Pin_t pin, pcal6524_InOut_t io);
+
+    /**
+     * @brief 				Turns several pins of all ports into outputs without glitches. The output registers are
+     * 						written before the configuration registers, each as one transaction covering only the
+     * 						changed span, or recorded in an open batch. Two transactions send fewer bytes than one
+     * 						burst across the five registers 0x07 - 0x0B in between.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	mask 		Pins to configure as outputs. Bit 0-7 port A, bit 8-15 port B, bit 16-23 port C.
+     * @param 	values 		Output values of these pins, same bit order. Bits outside mask are ignored.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_ConfigureOutputs(pcal6524_Device_t *device, uint32_t mask, uint32_t values);
+
+    /**
+     * @brief 				Streams a precomputed pattern to the output register of one port. All frames go out in a
+     * 						single write transaction with the auto-increment flag cleared, so the pins are updated at
+     * 						the byte rate of the bus (one frame every 9 SCL clocks). Uses the device transport, so
+     * 						the frames are moved by DMA with PCAL6524_TransportDMA. The shadow image keeps the last frame.
+     * 						Refused while a batch is open or pin marks of the port wait for a commit, since the
+     * 						commit would overwrite the last frame.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	port 		Port to drive.
+     * @param 	*frames 	Output register values in order.
+     * @param 	n 			Number of frames.
+     *
+     * @retval 	uint8_t		Error code. HAL_BUSY while a batch is open or the output register is pending.
+     */
+    uint8_t PCAL6524_StreamOutputs(pcal6524_Device_t *device, pcal6524_Port_t port, const uint8_t *frames, uint16_t n);
+
+    /**
+     * @brief 				Handles a falling edge of the INT pin. Call from HAL_GPIO_EXTI_Callback.
+     * 						Reads INT_STAT and IN_STATUS of all ports asynchronously, records an event
+     * 						and clears the reported pins. Needs DMA or IT transport; with DMA the reads start
+     * 						from PCAL6524_ServiceRetries in the main loop.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     *
+     * @retval 	uint8_t		Error code. PCAL6524_INPUTOUTOFRANGE with blocking or LL transport, which would
+     * 						wait on HAL_GetTick inside the EXTI interrupt.
+     */
+    uint8_t PCAL6524_HandleInterrupt(pcal6524_Device_t *device);
+
+    /**
+     * @brief 				Takes the oldest recorded input event. Does not access the bus.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	*event 		Output variable for the event.
+     *
+     * @retval 	uint8_t		1 if an event was taken, 0 if none is waiting.
+     */
+    uint8_t PCAL6524_PopEvent(pcal6524_Device_t *device, pcal6524_Event_t *event);
+
+    /**
+     * @brief Struct for a bank of up to four devices addressed as one block of 96 pins.
+     * Global pin index = 24 * slot + 8 * port + pin.
+     */
+    typedef struct
+    {
+        pcal6524_Device_t *devices[PCAL6524_BANK_SIZE]; ///< Devices by slot, NULL for an empty slot. Filled in by the caller.
+        uint8_t data[PCAL6524_BANK_SIZE][3];            ///< Transfer buffers of bank-wide reads and writes.
+        uint32_t done[PCAL6524_BANK_SIZE];              ///< Cycle count (DWT) at the end of each device transfer.
+        volatile uint8_t pending;                       ///< Device transfers still running.
+        volatile uint8_t status;                        ///< First error of the running bank-wide transfer.
+        uint32_t skew;                                  ///< Time between the first and the last device transfer of the last bank-wide read or write [ns].
+    } pcal6524_Bank_t;
+
+    /**
+     * @brief 				Initializes every device of the bank, see PCAL6524_Init. A device that fails does not
+     * 						hold back the others.
+     *
+     * @param 	*bank 		Bank with its devices filled in.
+     *
+     * @retval 	uint8_t		Error code of the first failing device. PCAL6524_INPUTOUTOFRANGE if two devices share an address.
+     */
+    uint8_t PCAL6524_BankInit(pcal6524_Bank_t *bank);
+
+    /**
+     * @brief 				Opens a batch on every device of the bank, see PCAL6524_BeginBatch.
+     *
+     * @param 	*bank 		Bank with its devices filled in.
+     */
+    void PCAL6524_BankBeginBatch(pcal6524_Bank_t *bank);
+
+    /**
+     * @brief 				Commits the batches of all devices one after the other, see PCAL6524_CommitBatch.
+     *
+     * @param 	*bank 		Bank with its devices filled in.
+     *
+     * @retval 	uint8_t		Error code of the first failing device.
+     */
+    uint8_t PCAL6524_BankCommitBatch(pcal6524_Bank_t *bank);
+
+    /**
+     * @brief 				Sets a pin of the bank as in- or output, see PCAL6524_SetInOut.
+     *
+     * @param 	*bank 		Bank with its devices filled in.
+     * @param 	index 		Global pin index, 0 to 95.
+     * @param 	io 			0 for output, 1 for input.
+     *
+     * @retval 	uint8_t		Error code. PCAL6524_INPUTOUTOFRANGE for an index of an empty slot.
+     */
+    uint8_t PCAL6524_BankSetInOut(pcal6524_Bank_t *bank, uint8_t index, pcal6524_InOut_t io);
+
+    /**
+     * @brief 				Sets the output value of a pin of the bank, see PCAL6524_OutputValue.
+     *
+     * @param 	*bank 		Bank with its devices filled in.
+     * @param 	index 		Global pin index, 0 to 95.
+     * @param 	value 		Value to output.
+     *
+     * @retval 	uint8_t		Error code. PCAL6524_INPUTOUTOFRANGE for an index of an empty slot.
+     */
+    uint8_t PCAL6524_BankOutputValue(pcal6524_Bank_t *bank, uint8_t index, pcal6524_Value_t value);
+
+    /**
+     * @brief 				Gets the value of a pin of the bank from IN_STATUS. Unlike PCAL6524_GetPinValue
+     * 						no interrupt is cleared, so pending events stay with the event pipe.
+     *
+     * @param 	*bank 		Bank with its devices filled in.
+     * @param 	index 		Global pin index, 0 to 95.
+     * @param 	*value 		Pointer to output variable.
+     *
+     * @retval 	uint8_t		Error code. PCAL6524_INPUTOUTOFRANGE for an index of an empty slot.
+     */
+    uint8_t PCAL6524_BankGetPinValue(pcal6524_Bank_t *bank, uint8_t index, pcal6524_Value_t *value);
+
+    /**
+     * @brief 				Reads the inputs of all devices. One read per device is queued before the first one
+     * 						starts, so the transfers follow each other back to back from the I2C interrupts.
+     * 						The spread of their completions is stored in bank->skew. Reads IN_STATUS, so
+     * 						interrupts pending on the chips are not cleared.
+     *
+     * @param 	*bank 		Bank with its devices filled in.
+     * @param 	*values 	Array of PCAL6524_BANK_SIZE entries for the input levels, 24 bits per device. 0 for empty slots.
+     *
+     * @retval 	uint8_t		Error code of the first failing device.
+     */
+    uint8_t PCAL6524_BankReadInputs(pcal6524_Bank_t *bank, uint32_t *values);
+
+    /**
+     * @brief 				Writes outputs of all devices. New register values are computed from the shadow images
+     * 						first, then one write per changed device (only its changed span) is queued, so the
+     * 						transfers follow each other back to back. The spread of their completions is stored in
+     * 						bank->skew. Devices with an open batch record the change instead.
+     *
+     * @param 	*bank 		Bank with its devices filled in.
+     * @param 	*values 	Array of PCAL6524_BANK_SIZE output values, 24 bits per device.
+     * @param 	*masks 		Array of PCAL6524_BANK_SIZE masks of the pins to change, 24 bits per device.
+     *
+     * @retval 	uint8_t		Error code of the first failing device.
+     */
+    uint8_t PCAL6524_BankWriteOutputs(pcal6524_Bank_t *bank, const uint32_t *values, const uint32_t *masks);
+
+#if defined(STM32F1)
+    /**
+     * @brief Struct for core cycles taken by driver calls with one transport.
+     */
+    typedef struct
+    {
+        uint32_t readRegister;       ///< ReadI2C of one register.
+        uint32_t readPair;           ///< ReadI2C of two registers.
+        uint32_t writeRegister;      ///< WriteI2C of one register, as issued by the pin setters.
+        uint32_t writeOutputs;       ///< WriteI2C of three registers, as issued by WriteOutputsMasked.
+        uint32_t getAllPinValues;    ///< PCAL6524_GetAllPinValues.
+        uint32_t getPinValue;        ///< PCAL6524_GetPinValue.
+        uint32_t getInterrupts;      ///< PCAL6524_GetInterrupts.
+        uint32_t clearAllInterrupts; ///< PCAL6524_ClearAllInterrupts.
+        uint32_t refreshShadow;      ///< PCAL6524_RefreshShadow.
+    } pcal6524_CallCycles_t;
+
+    /**
+     * @brief Struct for the cycle comparison of HAL and LL transport.
+     */
+    typedef struct
+    {
+        pcal6524_CallCycles_t hal; ///< Blocking HAL transport.
+        pcal6524_CallCycles_t ll;  ///< Register-level transport.
+    } pcal6524_TransportBenchmark_t;
+
+    /**
+     * @brief 				Measures the core cycles (DWT CYCCNT) of each bus-accessing driver call,
+     * 						once with the blocking HAL transport and once with the LL transport.
+     * 						Registers are written back with their shadow values. The transport is restored afterwards.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	*result 	Output variable for the cycle counts.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_BenchmarkTransport(pcal6524_Device_t *device, pcal6524_TransportBenchmark_t *result);
+
+    /**
+     * @brief Struct for the cost of a full 24-pin read and write at one bus speed.
+     */
+    typedef struct
+    {
+        uint32_t clockSpeed;  ///< Effective SCL frequency [Hz].
+        uint32_t readCycles;  ///< Core cycles of PCAL6524_GetAllPinValues, averaged.
+        uint32_t writeCycles; ///< Core cycles of a 3-byte output write, averaged.
+    } pcal6524_SpeedBenchmark_t;
+
+    /**
+     * @brief 				Measures full 24-pin read/write cycles at each bus speed of the speed table.
+     * 						Outputs are written back with their shadow values. The negotiated speed is restored afterwards.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	*result 	Array with one entry per bus speed, fastest first.
+     * @param 	count 		Entries in result, at most 2 are filled.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_BenchmarkBusSpeed(pcal6524_Device_t *device, pcal6524_SpeedBenchmark_t *result, uint8_t count);
+
+    /**
+     * @brief Struct for the output update rate of per-pin calls against a streamed pattern.
+     */
+    typedef struct
+    {
+        uint32_t outputValueCycles; ///< Core cycles per update with PCAL6524_OutputValue, averaged.
+        uint32_t streamCycles;      ///< Core cycles per frame with PCAL6524_StreamOutputs, averaged.
+        uint32_t outputValueRate;   ///< Updates per second with PCAL6524_OutputValue [Hz].
+        uint32_t streamRate;        ///< Frames per second with PCAL6524_StreamOutputs [Hz].
+    } pcal6524_StreamBenchmark_t;
+
+    /**
+     * @brief 				Measures the output update rate of PCAL6524_OutputValue against PCAL6524_StreamOutputs.
+     * 						Pin 0 of the port toggles during the measurement and ends with its previous value.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	port 		Port to drive.
+     * @param 	*result 	Pointer to output variable for the measurement.
+     *
+     * @retval 	uint8_t		Error code.
+     */
+    uint8_t PCAL6524_BenchmarkStream(pcal6524_Device_t *device, pcal6524_Port_t port, pcal6524_StreamBenchmark_t *result);
+
+    /**
+     * @brief Struct for the cost of marking one pin in the shadow image.
+     */
+    typedef struct
+    {
+        uint32_t bitBandCycles;  ///< Core cycles of PCAL6524_MarkOutput (bit-band stores), averaged.
+        uint32_t criticalCycles; ///< Core cycles of a masked read-modify-write under __disable_irq, averaged.
+    } pcal6524_BitBandBenchmark_t;
+
+    /**
+     * @brief 				Compares marking a pin through bit-band aliases with a masked read-modify-write in a
+     * 						critical section. Pin 0 of port A keeps its value and pending marks are restored, no transfer is made.
+     *
+     * @param   device      Struct with I2C handler and address pin status.
+     * @param 	*result 	Pointer to output variable for the measurement.
+     *
+     * @retval 	uint8_t		Error code. HAL_ERROR if the output register is not in the shadow image.
+     */
+    uint8_t PCAL6524_BenchmarkBitBand(pcal6524_Device_t *device, pcal6524_BitBandBenchmark_t *result);
+#endif
 
     /**
      * @}
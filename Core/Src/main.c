@@ -18,6 +18,7 @@
 /* USER CODE END Header */
 /* Includes ------------------------------------------------------------------*/
 #include "main.h"
+#include "dma.h"
 #include "i2c.h"
 #include "gpio.h"
 
@@ -29,8 +30,11 @@ extern I2C_HandleTypeDef hi2c1;
 // 2. 创建设备实例
 pcal6524_Device_t pcal_dev = {
     .hi2c = &hi2c1,
-    .a0 = PCAL6524_A0_GND  // 根据硬件连接配置A0引脚电平
+    .a0 = PCAL6524_A0_GND,  // 根据硬件连接配置A0引脚电平
+    .transport = PCAL6524_TransportDMA,  // 中断事件读取需要异步传输
+    .events = {.intPort = PCAL_INT_GPIO_Port, .intPin = PCAL_INT_Pin}  // INT引脚, 清除后检查是否仍为低
 };
+pcal6524_Event_t pcal_event;  // 最近一次输入变化事件
 pcal6524_Port_t  PCAL_port = PCAL6524_Port_A;
 pcal6524_Pin_t   PCAL_pin_num = PCAL6524_Pin_4;
 pcal6524_InOut_t PCAL_pin_inout = PCAL6524_Output;
@@ -92,8 +96,12 @@ int main(void)
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_DMA_Init();
   MX_I2C1_Init();
   /* USER CODE BEGIN 2 */
+  PCAL6524_Init(&pcal_dev);  //读取扩展芯片寄存器到影子缓存
+  PCAL6524_NegotiateBusSpeed(&pcal_dev);  //400kHz校验失败时降到100kHz
+  PCAL6524_SetInOut(&pcal_dev, PCAL_port, PCAL_pin_num, PCAL_pin_inout);  //设置A4脚为输出, 芯片复位后由PCAL6524_ServiceReset恢复
   /* USER CODE END 2 */
 
   /* Infinite loop */
@@ -102,11 +110,15 @@ int main(void)
   {
 	 // HAL_Delay(500);
     /* USER CODE END WHILE */
-	  PCAL6524_SetInOut(&pcal_dev, PCAL_port, PCAL_pin_num, PCAL_pin_inout);  //设置A4脚为输出
-	  HAL_Delay(1000);//延时1秒
 	  PCAL6524_OutputValue(&pcal_dev, PCAL_port, PCAL_pin_num, 1);//A4脚输出  1
 	  HAL_Delay(1000);//延时1秒
     /* USER CODE BEGIN 3 */
+	  PCAL6524_ServiceRetries();  //启动到期的异步重试传输
+	  PCAL6524_ServiceHealth(&pcal_dev);  //扩展芯片离线时定期探测, 恢复后重写配置
+	  PCAL6524_ServiceReset(&pcal_dev);  //定期读取一个寄存器, 发现芯片上电复位后重写配置
+	  while (PCAL6524_PopEvent(&pcal_dev, &pcal_event))  //取出中断中记录的输入变化, 不访问总线
+	  {
+	  }
   }
   /* USER CODE END 3 */
 }
@@ -151,6 +163,13 @@ void SystemClock_Config(void)
 }
 
 /* USER CODE BEGIN 4 */
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+  if (GPIO_Pin == PCAL_INT_Pin)
+  {
+    PCAL6524_HandleInterrupt(&pcal_dev);  //INT下降沿: 异步读取中断状态和输入状态
+  }
+}
 
 /* USER CODE END 4 */
 